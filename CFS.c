@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mythread.h"
+#include "sched.h"
+#include "pheap.h"
+
+/* Reparto justo de la CPU al estilo de CFS. Cada thread acumula un tiempo
+   virtual (vruntime): el tiempo que ha ejecutado multiplicado por
+   DEFAULT_WEIGHT / peso, asi que con peso doble avanza a la mitad y recibe
+   el doble de CPU. Siempre se elige el de menor vruntime, con un pairing
+   heap. El tiempo ejecutado sale de la contabilidad del nucleo, que lo
+   mide al cambiar de contexto, y no de los ticks: un thread que se bloquea
+   antes de un tick tambien paga lo que ha usado. La prioridad no se usa. */
+
+/* Periodo en el que todos los threads preparados deberian ejecutar una vez */
+#define LATENCIA (20 * 1000000LL)
+/* Rodaja minima, un tick */
+#define GRANULARIDAD (TICK_TIME * 1000LL)
+/* Ventaja en vruntime que necesita un thread que despierta para expulsar */
+#define GRANULARIDAD_DESPERTAR (1000000LL)
+
+static struct pheap preparados;
+/* Suma de los pesos de los threads en preparados */
+static long peso_total = 0;
+/* Nunca decrece: referencia para colocar a los threads que despiertan */
+static long long min_vruntime = 0;
+/* Tiempo ejecutado por el thread en ejecucion al empezar su rodaja */
+static long long inicio_rodaja = 0;
+
+static TCB* tcb_de(struct pheap_node* n){
+  return n ? queue_entry(n, TCB, node) : NULL;
+}
+
+/* Tiempo ejecutado por t, hasta ahora si esta en ejecucion */
+static long long ejecutado(TCB* t, int corriendo){
+  return t->stats.run_ns + (corriendo ? sched_now() - t->stamp : 0);
+}
+
+/* Suma a vruntime lo que t ha ejecutado desde la ultima vez */
+static void cobrar(TCB* t, int corriendo){
+  long long exec = ejecutado(t, corriendo);
+
+  t->vruntime += (exec - t->charged) * DEFAULT_WEIGHT / t->weight;
+  t->charged = exec;
+}
+
+static void actualizar_min(TCB* running){
+  TCB* primero = tcb_de(pheap_min(&preparados));
+  long long v;
+
+  if (running != NULL && running->state != IDLE){
+    v = running->vruntime;
+    if (primero != NULL && primero->vruntime < v) v = primero->vruntime;
+  } else if (primero != NULL){
+    v = primero->vruntime;
+  } else {
+    return;
+  }
+  if (v > min_vruntime) min_vruntime = v;
+}
+
+/* Un thread que ha pasado tiempo fuera de la cola, bloqueado, no conserva
+   lo que no gasto: como mucho queda media LATENCIA por delante de
+   min_vruntime */
+static void encolar(TCB* t){
+  if (t->vruntime < min_vruntime - LATENCIA / 2) t->vruntime = min_vruntime - LATENCIA / 2;
+  t->node.key = t->vruntime;
+  pheap_push(&preparados, &t->node);
+  peso_total += t->weight;
+}
+
+static void cfs_init(){
+  pheap_init(&preparados);
+}
+
+static void cfs_enqueue(TCB* t){
+  cobrar(t, 0);
+  encolar(t);
+}
+
+/* Lo ejecutado hasta ahora se cobra con el peso anterior */
+void cfs_setweight(TCB* running, int peso){
+  cobrar(running, 1);
+  running->weight = peso;
+}
+
+/* Rodaja del thread en ejecucion: su parte de LATENCIA segun su peso */
+static long long rodaja(TCB* running){
+  long long r = LATENCIA * running->weight / (peso_total + running->weight);
+
+  return r < GRANULARIDAD ? GRANULARIDAD : r;
+}
+
+static TCB* cfs_pick_next(){
+  TCB* t = tcb_de(pheap_pop(&preparados));
+
+  if (t == NULL) return NULL;
+  peso_total -= t->weight;
+  actualizar_min(t);
+  inicio_rodaja = t->stats.run_ns;
+  /* En modo tickless la interrupcion llega al final de la rodaja */
+  t->ticks = rodaja(t) / GRANULARIDAD;
+  return t;
+}
+
+static TCB* cfs_peek(){
+  return tcb_de(pheap_min(&preparados));
+}
+
+/* Expulsa al thread en ejecucion cuando ha gastado su rodaja y hay otro
+   con menos vruntime */
+static int cfs_on_tick(TCB* running){
+  TCB* primero = tcb_de(pheap_min(&preparados));
+
+  cobrar(running, 1);
+  actualizar_min(running);
+  if (primero == NULL) return 0;
+  if (ejecutado(running, 1) - inicio_rodaja < rodaja(running)) return 0;
+  return primero->vruntime < running->vruntime;
+}
+
+/* Un thread nuevo empieza en min_vruntime. Uno que despierta queda como
+   mucho media LATENCIA por delante (ver encolar()), asi que los threads de
+   E/S van casi delante de la cola pero su ventaja esta acotada. Expulsa al
+   thread en ejecucion si el que despierta le saca GRANULARIDAD_DESPERTAR */
+static int cfs_on_wakeup(TCB* running, TCB* t){
+  if (t->stats.dispatches == 0){
+    t->vruntime = min_vruntime;
+    t->charged = 0;
+  } else {
+    cobrar(t, 0);
+  }
+  encolar(t);
+  if (running->state == IDLE) return 0;
+  cobrar(running, 1);
+  return running->vruntime - t->vruntime > GRANULARIDAD_DESPERTAR;
+}
+
+struct sched_policy sched_cfs = {
+  .name = "cfs",
+  .disk = 1,
+  .smp = 0,
+  .init = cfs_init,
+  .enqueue = cfs_enqueue,
+  .pick_next = cfs_pick_next,
+  .peek = cfs_peek,
+  .on_tick = cfs_on_tick,
+  .on_block = NULL,
+  .on_wakeup = cfs_on_wakeup,
+};
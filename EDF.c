@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mythread.h"
+#include "sched.h"
+#include "pheap.h"
+
+/* Clase de tiempo real EDF (earliest deadline first), por encima de la
+   politica en uso: mientras haya un thread EDF preparado no se ejecuta
+   ningun otro. Cada thread EDF tiene una reserva: en cada periodo se activa
+   un trabajo que puede usar budget de CPU y debe acabar, llamando a
+   mythread_wait_period(), antes de su plazo. Siempre se elige el plazo mas
+   cercano, con un pairing heap. Una reserva solo se admite si la
+   utilizacion total cabe en UTIL_MAX. El presupuesto se hace cumplir desde
+   la interrupcion de reloj, con la precision de un tick: un trabajo que lo
+   agota se para hasta el periodo siguiente y sigue con un presupuesto
+   nuevo y el plazo de ese periodo (como en CBS), asi que un thread que se
+   pasa no hace fallar los plazos de los demas. Los fallos se cuentan con
+   el plazo original del trabajo. */
+
+/* Fases de un thread EDF (edf.phase) */
+#define EN_TRABAJO 0
+#define ESPERA_TRABAJO 1     /* Hasta la activacion del siguiente trabajo */
+#define ESPERA_PRESUPUESTO 2 /* Parado por agotar el presupuesto */
+
+/* Utilizacion maxima de la clase, en millonesimas: el resto de la CPU
+   queda para la politica */
+#define UTIL_MAX 900000L
+
+static struct pheap preparados;
+/* Suma de las utilizaciones admitidas */
+static long utilizacion = 0;
+
+static TCB* tcb_de(struct pheap_node* n){
+  return n ? queue_entry(n, TCB, node) : NULL;
+}
+
+/* Utilizacion de una reserva, redondeada hacia arriba. Con un plazo menor
+   que el periodo se usa la densidad, budget / plazo, y la prueba de
+   admision sigue siendo suficiente */
+static long densidad(long long budget, long long plazo){
+  return (budget * 1000000 + plazo - 1) / plazo;
+}
+
+/* Tiempo ejecutado por t, hasta ahora si esta en ejecucion */
+static long long ejecutado(TCB* t, int corriendo){
+  return t->stats.run_ns + (corriendo ? sched_now() - t->stamp : 0);
+}
+
+/* Presupuesto que le queda a t */
+static long long presupuesto(TCB* t, int corriendo){
+  return t->edf.budget - (ejecutado(t, corriendo) - t->edf.budget_start);
+}
+
+/* Da a t un presupuesto nuevo. Lo que gasto de mas con el anterior, ya
+   que solo se comprueba en cada tick, se descuenta del nuevo: a la larga
+   no usa mas CPU que la admitida */
+static void dar_presupuesto(TCB* t, int corriendo){
+  long long exceso = -presupuesto(t, corriendo);
+
+  t->edf.budget_start = ejecutado(t, corriendo) - (exceso > 0 ? exceso : 0);
+}
+
+/* Empieza el trabajo que se activa en edf.release */
+static void nuevo_trabajo(TCB* t, int corriendo){
+  t->edf.job_deadline = t->edf.deadline = t->edf.release + t->edf.rel_deadline;
+  t->edf.release += t->edf.period;
+  dar_presupuesto(t, corriendo);
+  t->edf.phase = EN_TRABAJO;
+}
+
+/* Un trabajo parado sigue en el periodo siguiente con un presupuesto nuevo
+   y el plazo de ese periodo, o en uno posterior si debe mas de un
+   presupuesto */
+static void recargar(TCB* t){
+  do {
+    t->edf.deadline = t->edf.release + t->edf.rel_deadline;
+    t->edf.release += t->edf.period;
+    dar_presupuesto(t, 0);
+  } while (presupuesto(t, 0) <= 0);
+  t->edf.phase = EN_TRABAJO;
+}
+
+/* Cuenta el trabajo en curso de t, que acaba ahora */
+static void contar(TCB* t){
+  long long retraso = sched_now() - t->edf.job_deadline;
+
+  t->stats.jobs++;
+  if (retraso > 0){
+    t->stats.misses++;
+    if (retraso > t->stats.max_lateness_ns) t->stats.max_lateness_ns = retraso;
+  }
+}
+
+/* Hay un thread EDF preparado con un plazo anterior al de running */
+static int hay_antes(TCB* running){
+  TCB* primero = tcb_de(pheap_min(&preparados));
+
+  if (primero == NULL) return 0;
+  return !edf_thread(running) || primero->edf.deadline < running->edf.deadline;
+}
+
+void edf_init(){
+  pheap_init(&preparados);
+}
+
+/* El primer trabajo se activa cuando el thread pasa a preparado */
+int edf_admit(TCB* t, long long period, long long budget, long long deadline){
+  long u;
+
+  if (budget <= 0 || budget > deadline || deadline > period) return -1;
+  u = densidad(budget, deadline);
+  if (utilizacion + u > UTIL_MAX) return -1;
+  utilizacion += u;
+  t->edf.period = period;
+  t->edf.budget = budget;
+  t->edf.rel_deadline = deadline;
+  t->edf.release = sched_now();
+  t->edf.phase = ESPERA_TRABAJO;
+  return 0;
+}
+
+/* Solo se cuentan los trabajos que acaban con mythread_wait_period(): el
+   que esta en curso al salir el thread no, ni aunque haya pasado su plazo */
+void edf_leave(TCB* t){
+  utilizacion -= densidad(t->edf.budget, t->edf.rel_deadline);
+  t->edf.period = 0;
+}
+
+void edf_enqueue(TCB* t){
+  t->node.key = t->edf.deadline;
+  pheap_push(&preparados, &t->node);
+}
+
+TCB* edf_pick_next(){
+  return tcb_de(pheap_pop(&preparados));
+}
+
+TCB* edf_peek(){
+  return tcb_de(pheap_min(&preparados));
+}
+
+long long edf_budget_left(TCB* running){
+  return presupuesto(running, 1);
+}
+
+/* Para al thread en ejecucion si ha agotado su presupuesto */
+int edf_on_tick(TCB* running){
+  if (presupuesto(running, 1) <= 0){
+    running->edf.phase = ESPERA_PRESUPUESTO;
+    return EDF_SLEEP;
+  }
+  return hay_antes(running);
+}
+
+/* Un thread que vuelve de esperar su periodo empieza un trabajo, y uno
+   parado recibe su presupuesto. Expulsa a cualquier thread de la politica
+   y a un thread EDF con un plazo posterior */
+int edf_on_wakeup(TCB* running, TCB* t){
+  if (t->edf.phase == ESPERA_TRABAJO) nuevo_trabajo(t, 0);
+  else if (t->edf.phase == ESPERA_PRESUPUESTO) recargar(t);
+  edf_enqueue(t);
+  if (running->state == IDLE) return 0;
+  return hay_antes(running);
+}
+
+/* Si el trabajo siguiente ya se tenia que haber activado empieza ahora,
+   con un plazo que puede haber pasado ya */
+int edf_complete(TCB* running){
+  contar(running);
+  if (running->edf.release > sched_now()){
+    running->edf.phase = ESPERA_TRABAJO;
+    return EDF_SLEEP;
+  }
+  nuevo_trabajo(running, 1);
+  return hay_antes(running);
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mythread.h"
+#include "sched.h"
+
+/* Cola multinivel con realimentacion (MLFQ). La politica no usa las
+   prioridades: coloca a cada thread segun como usa la CPU. Todos empiezan
+   en el nivel 0, el mas alto. Un thread que gasta su rodaja entera baja un
+   nivel, y uno que se bloquea en read_disk() sin haber gastado la mitad
+   sube uno, asi que los threads de E/S quedan arriba y expulsan a los de
+   calculo al despertar. Los niveles bajos tienen rodajas mas largas: sus
+   threads no se bloquean y asi cambian menos de contexto. Lo gastado de la
+   rodaja se conserva al bloquearse, y bloquearse justo antes de acabarla
+   no sirve para quedarse arriba. Cada BOOST ticks los threads de la cola y
+   el que esta en ejecucion vuelven al nivel 0: los de abajo no pasan
+   hambre y un thread que cambia de comportamiento no se queda abajo. */
+
+#define NIVELES 4
+/* Ticks entre dos subidas de todos al nivel 0 */
+#define BOOST (5 * QUANTUM_TICKS)
+
+/* Nivel 0 en el nivel mas alto de la cola */
+static struct runqueue preparados;
+
+/* Reloj de la politica en ticks */
+static long reloj = 0;
+
+/* Rodaja del nivel en ticks: QUANTUM_TICKS / 8 arriba, QUANTUM_TICKS abajo */
+static int rodaja(int nivel){
+  return (QUANTUM_TICKS / 8) << nivel;
+}
+
+static void encolar(TCB* t){
+  rq_push(&preparados, &t->link, NIVELES - 1 - t->level);
+}
+
+/* Hay un thread preparado en el nivel o por encima */
+static int hay_en(int nivel){
+  return rq_top(&preparados) >= NIVELES - 1 - nivel;
+}
+
+static void mlfq_init(){
+  rq_init(&preparados);
+}
+
+static void mlfq_enqueue(TCB* t){
+  encolar(t);
+}
+
+static TCB* mlfq_pick_next(){
+  struct queue_link* l = rq_pop(&preparados);
+  TCB* t;
+
+  if (l == NULL) return NULL;
+  t = queue_entry(l, TCB, link);
+  /* En modo tickless la interrupcion llega al final de lo que le queda */
+  t->ticks = rodaja(t->level) - t->used;
+  return t;
+}
+
+static TCB* mlfq_peek(){
+  int nivel = rq_top(&preparados);
+
+  return nivel < 0 ? NULL : queue_entry(rq_peek(&preparados, nivel), TCB, link);
+}
+
+/* Todos al nivel 0 con la rodaja entera */
+static void subir_todos(TCB* running){
+  struct queue_link* l;
+  int n;
+
+  for (n = 1; n < NIVELES; n++){
+    while ((l = rq_pop_level(&preparados, NIVELES - 1 - n)) != NULL){
+      TCB* t = queue_entry(l, TCB, link);
+
+      t->level = 0;
+      t->used = 0;
+      encolar(t);
+    }
+  }
+  running->level = 0;
+  running->used = 0;
+  running->ticks = rodaja(0);
+}
+
+/* Al gastar la rodaja entera el thread baja un nivel, y sigue si no hay
+   nadie preparado en su nuevo nivel o por encima */
+static int mlfq_on_tick(TCB* running){
+  if (++reloj % BOOST == 0){
+    subir_todos(running);
+    return !rq_empty(&preparados);
+  }
+  running->used++;
+  running->ticks = rodaja(running->level) - running->used;
+  if (running->ticks > 0){
+    return 0;
+  }
+  if (running->level < NIVELES - 1) running->level++;
+  running->used = 0;
+  running->ticks = rodaja(running->level);
+  return hay_en(running->level);
+}
+
+/* Se bloquea pronto: sube un nivel con la rodaja entera */
+static void mlfq_on_block(TCB* t){
+  if (2 * t->used < rodaja(t->level)){
+    if (t->level > 0) t->level--;
+    t->used = 0;
+  }
+}
+
+/* Expulsa al thread en ejecucion si el que despierta esta mas arriba */
+static int mlfq_on_wakeup(TCB* running, TCB* t){
+  encolar(t);
+  if (running->state == IDLE) return 0;
+  return t->level < running->level;
+}
+
+struct sched_policy sched_mlfq = {
+  .name = "mlfq",
+  .disk = 1,
+  .smp = 0,
+  .init = mlfq_init,
+  .enqueue = mlfq_enqueue,
+  .pick_next = mlfq_pick_next,
+  .peek = mlfq_peek,
+  .on_tick = mlfq_on_tick,
+  .on_block = mlfq_on_block,
+  .on_wakeup = mlfq_on_wakeup,
+};
@@ -1,222 +1,52 @@
 #include <stdio.h>
-#include <sys/time.h>
-#include <signal.h>
 #include <stdlib.h>
-#include <ucontext.h>
-#include <unistd.h>
 
 #include "mythread.h"
-#include "interrupt.h"
-
-#include "queue.h"
-
-TCB* scheduler();
-void activator();
-void timer_interrupt(int sig);
-void disk_interrupt(int sig);
+#include "sched.h"
 
 /* Cola de threads preparados*/ 
-struct queue *listos;
-
-/* Array of state thread control blocks: the process allows a maximum of N threads */
-static TCB t_state[N]; 
-
-/* Current running thread */
-static TCB* running;
-static int current = 0;
-
-/* Variable indicating if the library is initialized (init == 1) or not (init == 0) */
-static int init=0;
+static struct iqueue listos;
 
-/* Thread control block for the idle thread */
-static TCB idle;
-static void idle_function(){
-  while(1);
+static void rr_init(){
+  iqueue_init(&listos);
 }
 
-/* Initialize the thread library */
-void init_mythreadlib() {
-  int i;  
-  /* Create context for the idle thread */
-  if(getcontext(&idle.run_env) == -1){
-    perror("*** ERROR: getcontext in init_thread_lib");
-    exit(-1);
-  }
-  idle.state = IDLE;
-  idle.priority = SYSTEM;
-  idle.function = idle_function;
-  idle.run_env.uc_stack.ss_sp = (void *)(malloc(STACKSIZE));
-  idle.tid = -1;
-  if(idle.run_env.uc_stack.ss_sp == NULL){
-    printf("*** ERROR: thread failed to get stack space\n");
-    exit(-1);
-  }
-  idle.run_env.uc_stack.ss_size = STACKSIZE;
-  idle.run_env.uc_stack.ss_flags = 0;
-  idle.ticks = QUANTUM_TICKS;
-  makecontext(&idle.run_env, idle_function, 1); 
-
-  t_state[0].state = INIT;
-  t_state[0].priority = LOW_PRIORITY;
-  t_state[0].ticks = QUANTUM_TICKS;
-  if(getcontext(&t_state[0].run_env) == -1){
-    perror("*** ERROR: getcontext in init_thread_lib");
-    exit(5);
-  }	
-
-  for(i=1; i<N; i++){
-    t_state[i].state = FREE;
-  }
- 
-  t_state[0].tid = 0;
-  running = &t_state[0];
-
-  /* Inicializa la cola de threads preparados*/
-  listos = queue_new();
-
-  /* Initialize disk and clock interrupts */
-  init_disk_interrupt();
-  init_interrupt();
+/* Encola el proceso antiguo para reanudarlo en el futuro */
+static void rr_enqueue(TCB* t){
+  tcb_enqueue(&listos, t);
 }
 
-
-/* Create and intialize a new thread with body fun_addr and one integer argument */ 
-int mythread_create (void (*fun_addr)(),int priority)
-{
-  int i;
-  
-  if (!init) { init_mythreadlib(); init=1;}
-  for (i=0; i<N; i++)
-    if (t_state[i].state == FREE) break;
-  if (i == N) return(-1);
-  if(getcontext(&t_state[i].run_env) == -1){
-    perror("*** ERROR: getcontext in my_thread_create");
-    exit(-1);
-  }
-  t_state[i].state = INIT;
-  t_state[i].priority = priority;
-  t_state[i].function = fun_addr;
-  t_state[i].run_env.uc_stack.ss_sp = (void *)(malloc(STACKSIZE));
-  if(t_state[i].run_env.uc_stack.ss_sp == NULL){
-    printf("*** ERROR: thread failed to get stack space\n");
-    exit(-1);
-  }
-  t_state[i].tid = i;
-  t_state[i].run_env.uc_stack.ss_size = STACKSIZE;
-  t_state[i].run_env.uc_stack.ss_flags = 0;
-  makecontext(&t_state[i].run_env, fun_addr, 1); 
-
-  /*Añadimos el thread a la cola de preparados*/
-  TCB *state = &t_state[i];
-  enqueue(listos, state);
-
-  return i;
-} /****** End my_thread_create() ******/
-
-/* Read disk syscall */
-int read_disk()
-{
-   return 1;
-}
-
-/* Disk interrupt  */
-void disk_interrupt(int sig)
-{
-} 
-
-
-/* Free terminated thread and exits */
-void mythread_exit() {
-  int tid = mythread_gettid();	
-
-  printf("*** THREAD %d FINISHED\n", tid);	
-  t_state[tid].state = FREE;
-  free(t_state[tid].run_env.uc_stack.ss_sp); 
-
-  TCB* next = scheduler();
-  activator(next);
+/* Asigna el próximo proceso listo */
+static TCB* rr_pick_next(){
+  return tcb_dequeue(&listos);
 }
 
-/* Sets the priority of the calling thread */
-void mythread_setpriority(int priority) {
-  int tid = mythread_gettid();	
-  t_state[tid].priority = priority;
+static TCB* rr_peek(){
+  return tcb_peek(&listos);
 }
 
-/* Returns the priority of the calling thread */
-int mythread_getpriority(int priority) {
-  int tid = mythread_gettid();	
-  return t_state[tid].priority;
-}
-
-
-/* Get the current thread id.  */
-int mythread_gettid(){
-  if (!init) { init_mythreadlib(); init=1;}
-  return current;
-}
-
-
-/* RoundRobin separado en ticks de tiempo (rodajas)*/
-TCB* scheduler(){
- // Comprueba si la cola está vacía
- if (queue_empty(listos) == 0){
-  // Desactiva las interrupciones durante la manipulación de la cola de procesos
-  disable_interrupt();
-  // Asigna el próximo proceso listo 
-  TCB* siguiente = dequeue(listos);
-  enable_interrupt();
-  // Reactiva las interupciones
-  return siguiente;
- }
- // Comprueba si hay algún proceso en curso cuando la cola de procesos está vacía
- if (running->state==INIT){
-  return running;
- }
-
-  // Procesos finalizados
-  printf("*** FINISH\n"); 
-  exit(1); 
-}
-
-
-/* Timer interrupt  */
-void timer_interrupt(int sig)
-{
+/* RoundRobin separado en ticks de tiempo (rodajas): se expulsa al proceso
+   en curso cuando no quedan ticks restantes en su rodaja */
+static int rr_on_tick(TCB* running){
   running->ticks = (running->ticks) - 1;
-
-  /* Lanza el scheduler y activator cuando no quedan ticks
-  restantes en la rodaja del proceso en curso */
-  if (running->ticks <= 0){
-    TCB *siguiente = scheduler();
-    activator(siguiente);
-  }
-} 
-
-/* Activator para realizar el cambio de contexto*/
-void activator(TCB* siguiente){
-
-  // Asigna los ticks que componen cada rodaja
-  running->ticks= QUANTUM_TICKS;
-  //Guarda el contexto del proceso saliente
-  TCB* tcb_anterior = running;
-  // Asigna el próximo proceso como el actual
-  running = siguiente;
-  current = running->tid;
-
-  // Si un proceso finaliza y se libera, se asigna el contexto del nuevo proceso
-  if (tcb_anterior->state == FREE){
-    printf("*** THREAD %d TERMINATED: SET CONTEXT OF %d\n", tcb_anterior->tid, running->tid);
-    setcontext (&(siguiente->run_env));
-  }
-  disable_interrupt();
-  // Encola el proceso antiguo para reanudarlo en el futuro
-  enqueue(listos, tcb_anterior);
-  enable_interrupt();
-  // Realiza el cambio de contexto
-  printf("*** SWAPCONTEXT FROM %d TO %d\n", tcb_anterior->tid,running->tid);
-  swapcontext(&tcb_anterior->run_env, &running->run_env);
-}
-
-
-
+  return (running->ticks <= 0);
+}
+
+/* Los threads nuevos esperan su turno al final de la cola */
+static int rr_on_wakeup(TCB* running, TCB* t){
+  tcb_enqueue(&listos, t);
+  return 0;
+}
+
+struct sched_policy sched_rr = {
+  .name = "rr",
+  .disk = 0,
+  .smp = 0,
+  .init = rr_init,
+  .enqueue = rr_enqueue,
+  .pick_next = rr_pick_next,
+  .peek = rr_peek,
+  .on_tick = rr_on_tick,
+  .on_block = NULL,
+  .on_wakeup = rr_on_wakeup,
+};
@@ -1,247 +1,134 @@
 #include <stdio.h>
-#include <sys/time.h>
-#include <signal.h>
 #include <stdlib.h>
-#include <ucontext.h>
-#include <unistd.h>
 
 #include "mythread.h"
-#include "interrupt.h"
+#include "sched.h"
 
-#include "queue.h"
+/* cola de preparados con un nivel por prioridad */
+static struct runqueue preparados;
+/* Threads promovidos por el envejecimiento, por delante de todos */
+static struct iqueue hambrientos;
 
-TCB* scheduler();
-void activator();
-void timer_interrupt(int sig);
-void disk_interrupt(int sig);
+/* Reloj de la politica en ticks, para el envejecimiento */
+static long reloj = 0;
+/* Ultimo nivel revisado por el envejecimiento */
+static int revisado = -1;
 
-/* Array of state thread control blocks: the process allows a maximum of N threads */
-static TCB t_state[N]; 
-
-/* actual en_ejecucion thread */
-static TCB* en_ejecucion;
-static int actual = 0;
-
-/* Variable indicating if the library is initialized (init == 1) or not (init == 0) */
-static int init=0;
-
-/* colas de prioridades */
-struct queue* alta_prioridad;
-struct queue* baja_prioridad;
-
-/* Thread control block for the idle thread */
-static TCB idle;
-static void idle_function(){
-  while(1);
-}
-
-/* Initialize the thread library */
-void init_mythreadlib() {
-  int i;  
-  /* Create context for the idle thread */
-  if(getcontext(&idle.run_env) == -1){
-    perror("*** ERROR: getcontext in init_thread_lib");
-    exit(-1);
-  }
-  idle.state = IDLE;
-  idle.priority = SYSTEM;
-  idle.function = idle_function;
-  idle.run_env.uc_stack.ss_sp = (void *)(malloc(STACKSIZE));
-  idle.tid = -1;
-  if(idle.run_env.uc_stack.ss_sp == NULL){
-    printf("*** ERROR: thread failed to get stack space\n");
-    exit(-1);
-  }
-  idle.run_env.uc_stack.ss_size = STACKSIZE;
-  idle.run_env.uc_stack.ss_flags = 0;
-  idle.ticks = QUANTUM_TICKS;
-  makecontext(&idle.run_env, idle_function, 1); 
-
-  t_state[0].state = INIT;
-  t_state[0].priority = LOW_PRIORITY;
-  t_state[0].ticks = QUANTUM_TICKS;
-  if(getcontext(&t_state[0].run_env) == -1){
-    perror("*** ERROR: getcontext in init_thread_lib");
-    exit(5);
-  }	
- 	
-  //inicializo las dos colas de prioridades
-  alta_prioridad = queue_new ();
-  baja_prioridad = queue_new ();
-
-  for(i=1; i<N; i++){
-    t_state[i].state = FREE;
-  }
- 
-  t_state[0].tid = 0;
-  en_ejecucion = &t_state[0];
-
-  /* Initialize disk and clock interrupts */
-  init_disk_interrupt();
-  init_interrupt();
+void rrf_init(){
+  rq_init(&preparados);
+  iqueue_init(&hambrientos);
 }
 
-
-/* Create and intialize a new thread with body fun_addr and one integer argument */ 
-int mythread_create (void (*fun_addr)(),int priority)
-{
-  int i;
-  
-  if (!init) { init_mythreadlib(); init=1;}
-  for (i=0; i<N; i++)
-    if (t_state[i].state == FREE) break;
-  if (i == N) return(-1);
-  if(getcontext(&t_state[i].run_env) == -1){
-    perror("*** ERROR: getcontext in my_thread_create");
-    exit(-1);
-  }
-  t_state[i].state = INIT;
-  t_state[i].priority = priority;
-  t_state[i].function = fun_addr;
-  t_state[i].run_env.uc_stack.ss_sp = (void *)(malloc(STACKSIZE));
-  if(t_state[i].run_env.uc_stack.ss_sp == NULL){
-    printf("*** ERROR: thread failed to get stack space\n");
-    exit(-1);
-  }
-  t_state[i].tid = i;
-  t_state[i].run_env.uc_stack.ss_size = STACKSIZE;
-  t_state[i].run_env.uc_stack.ss_flags = 0;
-  makecontext(&t_state[i].run_env, fun_addr, 1); 
-
-  TCB *actual = &t_state[i];
-
-  if(priority==HIGH_PRIORITY){    
-    if (queue_empty(alta_prioridad) == 1 && en_ejecucion->priority == LOW_PRIORITY){ /* o igual a 0¿?*/
-      activator(actual);
-    }else{
-      disable_interrupt();
-      enqueue(alta_prioridad, &t_state[i]);
-      enable_interrupt();
-    }
-  }
-  if(priority==LOW_PRIORITY){
-    disable_interrupt();
-    enqueue(baja_prioridad, &t_state[i]); 
-    enable_interrupt();
+/* Un thread promovido sigue promovido hasta acabar su rodaja, aunque le
+   expulsen antes */
+static void encolar(TCB* t){
+  if (t->boost){
+    tcb_enqueue(&hambrientos, t);
+    return;
   }
-  return i;
-} /****** End my_thread_create() ******/
-
-/* Read disk syscall */
-int read_disk()
-{
-   return 1;
-}
-
-/* Disk interrupt  */
-void disk_interrupt(int sig)
-{
-} 
-
-
-/* Free terminated thread and exits */
-void mythread_exit() {
-  int tid = mythread_gettid();	
-  printf("*** THREAD %d FINISHED\n", tid);
-  //preparamos el thread a ejecutar
-  TCB* siguiente = scheduler();	
-  t_state[tid].state = FREE;
-  free(t_state[tid].run_env.uc_stack.ss_sp);
-  //lanzamos la ejecucion 
-  activator(siguiente);
+  t->ready_tick = reloj;
+  tcb_rq_push(&preparados, t);
 }
 
-/* Sets the priority of the calling thread */
-void mythread_setpriority(int priority) {
-  int tid = mythread_gettid();	
-  t_state[tid].priority = priority;
+void rrf_enqueue(TCB* t){
+  encolar(t);
 }
 
-/* Returns the priority of the calling thread */
-int mythread_getpriority(int priority) {
-  int tid = mythread_gettid();	
-  return t_state[tid].priority;
+/* Envejecimiento: un thread que lleva STARVATION ticks en la cola se
+   promueve, pasa por delante de todos y no le expulsa nadie de la politica
+   hasta acabar una rodaja entera. Despues vuelve a su nivel y a esperar:
+   por debajo de threads de mas prioridad que no sueltan la CPU recibe una
+   rodaja cada STARVATION ticks. Cada nivel es FIFO, asi que el que mas
+   espera de un nivel es el primero. En cada tick se mira el primero de un
+   solo nivel no vacio por debajo de prio, por turnos con el bitmap: un
+   thread hambriento se ve como mucho tantos ticks tarde como niveles no
+   vacios haya. Devuelve 1 si ha promovido a uno */
+static int envejecer(int prio){
+  int l = rq_next(&preparados, revisado + 1);
+  TCB* t;
+
+  if (l < 0 || l >= prio) l = rq_next(&preparados, 0);
+  if (l < 0 || l >= prio){
+    revisado = -1;
+    return 0;
+  }
+  revisado = l;
+  t = queue_entry(rq_peek(&preparados, l), TCB, link);
+  if (reloj - t->ready_tick < STARVATION) return 0;
+  rq_pop_level(&preparados, l);
+  t->boost = 1;
+  tcb_enqueue(&hambrientos, t);
+  return 1;
 }
 
+/* FIFO para alta prioridad, RR para baja: coge el primero del nivel de
+   prioridad mas alto que no este vacio, salvo que haya uno promovido */
+TCB* rrf_pick_next(){
+  TCB* t = tcb_dequeue(&hambrientos);
 
-/* Get the actual thread id.  */
-int mythread_gettid(){
-  if (!init) { init_mythreadlib(); init=1;}
-  return actual;
+  return t ? t : tcb_rq_pop(&preparados);
 }
 
+TCB* rrf_peek(){
+  TCB* t = tcb_peek(&hambrientos);
+  int nivel;
 
-/* FIFO para alta prioridad, RR para baja*/
-TCB* scheduler(){
-  //se rehece extrayendo las prioridades segun el ejercicio como lo indica
-  if(queue_empty(alta_prioridad)== 0){ //la cola de prioridad alta no esta vacia 
-    // coge el de prioridad uno
-    disable_interrupt();
-    TCB *p = dequeue(alta_prioridad);
-    enable_interrupt();
-	  return p;
-  //}else{ //pasamos a los de priodidad baja cuando ya no quedan en la de alta prioridad
-  }
-
-  if (queue_empty(baja_prioridad)==0){
-    disable_interrupt();
-    TCB* p = dequeue(baja_prioridad);
-    enable_interrupt();
-    return p;
-  }
-  if (en_ejecucion->state==INIT){
-    return en_ejecucion;
-  }
-  
-  printf("*** FINISH\n");
-  exit(1); 
+  if (t != NULL) return t;
+  nivel = rq_top(&preparados);
+  return nivel < 0 ? NULL : queue_entry(rq_peek(&preparados, nivel), TCB, link);
 }
 
-
-/* Timer interrupt  */
-void timer_interrupt(int sig)
-{
-  if (en_ejecucion->priority == HIGH_PRIORITY){
-    return;
+/* Los threads de alta prioridad no tienen rodaja. Al acabar la rodaja solo
+   se cede la CPU a threads de igual o mayor prioridad. Un thread promovido
+   siempre tiene rodaja, y al acabarla deja de estarlo y cede la CPU. Si hay
+   uno promovido esperando se expulsa al thread, salvo que tambien lo sea */
+int rrf_on_tick(TCB* running){
+  reloj++;
+  envejecer(running->priority);
+  if (running->boost){
+    running->ticks = (running->ticks) - 1;
+    if (running->ticks > 0){
+      return 0;
+    }
+    running->boost = 0;
+    return 1;
   }
-  en_ejecucion->ticks = (en_ejecucion->ticks) - 1;
-  if (en_ejecucion->ticks <= 0){
-    TCB *siguiente = scheduler();
-    activator(siguiente);
+  if (!iqueue_empty(&hambrientos)){
+    return 1;
   }
-} 
-
-/* Activator */
-void activator(TCB* siguiente){
-  en_ejecucion->ticks= QUANTUM_TICKS;
-  // se le ponen los ticks por defecto para optimizar el programa
-  if (en_ejecucion == siguiente){
-    // se devuelve NULL si el que esta en ejecucion es el que se ejecutara a continuacion
-    return;
+  if (running->priority >= HIGH_PRIORITY){
+    return 0;
   }
-  TCB* anterior = en_ejecucion;
-  en_ejecucion = siguiente;
-  actual = en_ejecucion->tid;
-
-
-  if (anterior->state == FREE){
-    //solo se ejecuta cuando se produce un cambio de contexto
-    printf("*** THREAD %d TERMINATED: SET CONTEXT OF %d\n", anterior->tid, en_ejecucion->tid);
-    setcontext (&(siguiente->run_env));
+  running->ticks = (running->ticks) - 1;
+  if (running->ticks > 0){
+    return 0;
   }
-  disable_interrupt();
-  enqueue(baja_prioridad, anterior);
-  enable_interrupt();
-
-  /*****Just check if the thread was ejected or he just finish her quantum */
-  /*If they was ejected*/
-  if (en_ejecucion->priority == HIGH_PRIORITY){
-    printf("*** THREAD %d PREEMTED: SET CONTEXT OF %d\n", anterior->tid, en_ejecucion->tid);
-  } else {
-    printf("*** SWAPCONTEXT FROM %d TO %d\n", anterior->tid,en_ejecucion->tid);
+  if (rq_top(&preparados) < running->priority){
+    running->ticks = QUANTUM_TICKS;
+    return 0;
   }
-  swapcontext(&anterior->run_env, &en_ejecucion->run_env);
+  return 1;
 }
 
+/* expulsa al thread en ejecucion si el nuevo tiene mas prioridad y no hay
+   otro igual o mas prioritario esperando, salvo que este promovido. Un
+   thread que se bloqueo pierde la promocion */
+int rrf_on_wakeup(TCB* running, TCB* t){
+  int preempt = (t->priority > running->priority && rq_top(&preparados) < t->priority && !running->boost);
+  t->boost = 0;
+  encolar(t);
+  return preempt;
+}
 
-
+struct sched_policy sched_rrf = {
+  .name = "rrf",
+  .disk = 0,
+  .smp = 0,
+  .init = rrf_init,
+  .enqueue = rrf_enqueue,
+  .pick_next = rrf_pick_next,
+  .peek = rrf_peek,
+  .on_tick = rrf_on_tick,
+  .on_block = NULL,
+  .on_wakeup = rrf_on_wakeup,
+};
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "mythread.h"
+#include "sched.h"
+#include "spinlock.h"
+
+/* Work stealing para el modo M:N. Cada worker tiene un deque de Chase-Lev:
+   el propio worker mete y saca por abajo (LIFO) y los demas roban por
+   arriba (FIFO). Los threads expulsados van a una cola global (inject) para
+   que no vuelvan a ejecutarse antes que los demas. Las prioridades no se
+   tienen en cuenta. */
+
+#define DEQUE_SIZE 4096     /* Potencia de 2 */
+#define INJECT_EVERY 61     /* Cada cuantas elecciones se mira antes la cola global */
+
+struct deque
+{
+  atomic_long top;
+  atomic_long bottom;
+  TCB* _Atomic buf[DEQUE_SIZE];
+  unsigned int seed;        /* Para elegir la victima de los robos */
+  unsigned int picks;
+} __attribute__((aligned(64)));
+
+static struct deque* deques = NULL;
+static int ndeques = 0;
+
+/* Cola global de threads expulsados o que no caben en un deque */
+static struct iqueue inject;
+static spinlock_t inject_lock = SPINLOCK_INIT;
+
+static void inject_push(TCB* t){
+  spin_lock(&inject_lock);
+  tcb_enqueue(&inject, t);
+  spin_unlock(&inject_lock);
+}
+
+static TCB* inject_pop(){
+  TCB* t;
+
+  if (iqueue_empty(&inject)) return NULL;
+  spin_lock(&inject_lock);
+  t = tcb_dequeue(&inject);
+  spin_unlock(&inject_lock);
+  return t;
+}
+
+/* Solo el dueño del deque. Devuelve -1 si esta lleno */
+static int deque_push(struct deque* d, TCB* t){
+  long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  long tp = atomic_load_explicit(&d->top, memory_order_acquire);
+
+  if (b - tp >= DEQUE_SIZE) return -1;
+  atomic_store_explicit(&d->buf[b & (DEQUE_SIZE - 1)], t, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  return 0;
+}
+
+/* Solo el dueño del deque: saca el ultimo que metio */
+static TCB* deque_pop(struct deque* d){
+  long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  long tp;
+  TCB* t = NULL;
+
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  tp = atomic_load_explicit(&d->top, memory_order_relaxed);
+  if (tp <= b){
+    t = atomic_load_explicit(&d->buf[b & (DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (tp == b){
+      /* Ultimo elemento: compite con los ladrones */
+      if (!atomic_compare_exchange_strong_explicit(&d->top, &tp, tp + 1,
+                                                   memory_order_seq_cst, memory_order_relaxed))
+        t = NULL;
+      atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+  } else {
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  }
+  return t;
+}
+
+/* Cualquier worker: saca el mas antiguo. NULL si esta vacio o pierde la carrera */
+static TCB* deque_steal(struct deque* d){
+  long tp = atomic_load_explicit(&d->top, memory_order_acquire);
+  long b;
+  TCB* t;
+
+  atomic_thread_fence(memory_order_seq_cst);
+  b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+  if (tp >= b) return NULL;
+  t = atomic_load_explicit(&d->buf[tp & (DEQUE_SIZE - 1)], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &tp, tp + 1,
+                                               memory_order_seq_cst, memory_order_relaxed))
+    return NULL;
+  return t;
+}
+
+static void ws_init(){
+  int i;
+
+  ndeques = sched_nworkers();
+  deques = aligned_alloc(64, ndeques * sizeof(struct deque));
+  if (deques == NULL){
+    printf("*** ERROR: no memory for the run queues\n");
+    exit(-1);
+  }
+  for (i = 0; i < ndeques; i++){
+    atomic_init(&deques[i].top, 0);
+    atomic_init(&deques[i].bottom, 0);
+    deques[i].seed = 2463534242u + i;
+    deques[i].picks = 0;
+  }
+  iqueue_init(&inject);
+}
+
+/* El thread expulsado espera en la cola global, detras de los demas */
+static void ws_enqueue(TCB* t){
+  inject_push(t);
+}
+
+static TCB* ws_steal(struct deque* self){
+  TCB* t;
+  int i, victim;
+
+  self->seed ^= self->seed << 13;
+  self->seed ^= self->seed >> 17;
+  self->seed ^= self->seed << 5;
+  victim = self->seed % ndeques;
+  for (i = 0; i < ndeques; i++, victim = (victim + 1) % ndeques){
+    if (&deques[victim] == self) continue;
+    t = deque_steal(&deques[victim]);
+    if (t != NULL) return t;
+  }
+  return NULL;
+}
+
+/* Deque propio, cola global y por ultimo robo. De vez en cuando se mira
+   primero la cola global para que los expulsados no esperen siempre */
+static TCB* ws_pick_next(){
+  struct deque* d = &deques[sched_worker_id()];
+  TCB* t = NULL;
+
+  if (++d->picks % INJECT_EVERY == 0) t = inject_pop();
+  if (t == NULL) t = deque_pop(d);
+  if (t == NULL) t = inject_pop();
+  if (t == NULL) t = ws_steal(d);
+  return t;
+}
+
+static int ws_on_tick(TCB* running){
+  running->ticks = (running->ticks) - 1;
+  return (running->ticks <= 0);
+}
+
+/* Los threads nuevos y los que vuelven del disco van al deque del worker
+   que los despierta, donde los demas pueden robarlos */
+static int ws_on_wakeup(TCB* running, TCB* t){
+  if (deque_push(&deques[sched_worker_id()], t) == -1)
+    inject_push(t);
+  return 0;
+}
+
+struct sched_policy sched_ws = {
+  .name = "ws",
+  .disk = 1,
+  .smp = 1,
+  .init = ws_init,
+  .enqueue = ws_enqueue,
+  .pick_next = ws_pick_next,
+  .peek = NULL,
+  .on_tick = ws_on_tick,
+  .on_block = NULL,
+  .on_wakeup = ws_on_wakeup,
+};
@@ -0,0 +1,163 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Where results are written. The library logs every scheduling event on
+   stdout, so benchmarks that run threads call bench_quiet() first */
+static FILE* bench_out;
+
+/* Results are a table for people, or one JSON object per line with
+   BENCH_FORMAT=json, to compare runs from a script */
+static inline int bench_json(void)
+{
+  const char* f = getenv("BENCH_FORMAT");
+  return f != NULL && strcmp(f, "json") == 0;
+}
+
+static inline FILE* bench_file(void)
+{
+  return bench_out ? bench_out : stdout;
+}
+
+/* Single-worker policies to run a benchmark with: all of them, or only
+   MYTHREAD_POLICY if it is set. The list ends with NULL */
+static inline const char** bench_policies(void)
+{
+  static const char* all[] = { "rr", "rrf", "rrfd", "cfs", "mlfq", NULL };
+  static const char* one[] = { NULL, NULL };
+
+  one[0] = getenv("MYTHREAD_POLICY");
+  return one[0] != NULL ? one : all;
+}
+
+/* Send stdout to /dev/null and keep the results on the original stdout */
+static inline void bench_quiet(void)
+{
+  fflush(stdout);
+  bench_out = fdopen(dup(STDOUT_FILENO), "w");
+  if (freopen("/dev/null", "w", stdout) == NULL)
+    perror("freopen");
+}
+
+/* Run fn(arg) in a child process and wait for it. The library state
+   cannot be reset, so every variant of a benchmark that runs threads gets
+   a fresh process. Returns 0, or -1 after reporting label on stderr if the
+   child crashed or exited with a nonzero status */
+static inline int bench_isolated(void (*fn)(void* arg), void* arg, const char* label)
+{
+  int status;
+  pid_t pid;
+
+  fflush(stdout);
+  pid = fork();
+  if (pid == -1) {
+    perror("fork");
+    return -1;
+  }
+  if (pid == 0) {
+    fn(arg);
+    exit(0);
+  }
+  if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s failed\n", label);
+    return -1;
+  }
+  return 0;
+}
+
+/* Monotonic time in nanoseconds */
+static inline long long bench_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Cycle counter for timing a single short operation: the TSC on x86-64,
+   nanoseconds elsewhere */
+static inline unsigned long long bench_cycles(void)
+{
+#if defined(__x86_64__)
+  unsigned int lo, hi;
+  __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((unsigned long long) hi << 32) | lo;
+#else
+  return bench_now_ns();
+#endif
+}
+
+/* Cycles of bench_cycles() per nanosecond, measured the first time */
+static inline double bench_cycles_per_ns(void)
+{
+  static double rate = 0;
+
+  if (rate == 0) {
+    struct timespec ts = { 0, 20000000 };
+    long long t0 = bench_now_ns();
+    unsigned long long c0 = bench_cycles();
+
+    nanosleep(&ts, NULL);
+    rate = (double) (bench_cycles() - c0) / (bench_now_ns() - t0);
+  }
+  return rate;
+}
+
+/* Print one result line: benchmark name, variant and nanoseconds per operation */
+static inline void bench_report(const char* bench, const char* variant, long long ns, long ops)
+{
+  if (bench_json())
+    fprintf(bench_file(), "{\"bench\":\"%s\",\"variant\":\"%s\",\"ns_per_op\":%.2f,\"ops\":%ld}\n",
+            bench, variant, (double) ns / ops, ops);
+  else
+    fprintf(bench_file(), "%-12s %-14s %10.2f ns/op  (%ld ops)\n",
+            bench, variant, (double) ns / ops, ops);
+}
+
+/* Print any other measure of a run, with its unit */
+static inline void bench_value(const char* bench, const char* variant, double value, const char* unit)
+{
+  if (bench_json())
+    fprintf(bench_file(), "{\"bench\":\"%s\",\"variant\":\"%s\",\"value\":%.3f,\"unit\":\"%s\"}\n",
+            bench, variant, value, unit);
+  else
+    fprintf(bench_file(), "%-12s %-14s %10.2f %s\n", bench, variant, value, unit);
+}
+
+static inline int bench_cmp(const void* a, const void* b)
+{
+  unsigned long long x = *(const unsigned long long*) a, y = *(const unsigned long long*) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Print the distribution of n samples taken with bench_cycles(): median,
+   90th, 99th and 99.9th percentiles and maximum, in nanoseconds and in
+   cycles. Sorts the samples */
+static inline void bench_percentiles(const char* bench, const char* variant, unsigned long long* cycles, long n)
+{
+  double rate = bench_cycles_per_ns();
+  double pct[] = { 50, 90, 99, 99.9, 100 };
+  unsigned long long v[5];
+  int i;
+
+  qsort(cycles, n, sizeof(cycles[0]), bench_cmp);
+  for (i = 0; i < 5; i++) {
+    long k = (long) (pct[i] / 100 * n);
+    v[i] = cycles[k < n ? k : n - 1];
+  }
+  if (bench_json())
+    fprintf(bench_file(), "{\"bench\":\"%s\",\"variant\":\"%s\",\"samples\":%ld,"
+            "\"p50_ns\":%.1f,\"p90_ns\":%.1f,\"p99_ns\":%.1f,\"p999_ns\":%.1f,\"max_ns\":%.1f,"
+            "\"p50_cycles\":%llu,\"p99_cycles\":%llu}\n",
+            bench, variant, n, v[0] / rate, v[1] / rate, v[2] / rate, v[3] / rate, v[4] / rate, v[0], v[2]);
+  else
+    fprintf(bench_file(), "%-12s %-14s p50 %9.1f  p90 %9.1f  p99 %9.1f  p99.9 %9.1f  max %9.1f ns  (p50 %llu cycles)\n",
+            bench, variant, v[0] / rate, v[1] / rate, v[2] / rate, v[3] / rate, v[4] / rate, v[0]);
+}
+
+#endif
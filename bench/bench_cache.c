@@ -0,0 +1,83 @@
+/* Hit rate of the block cache against its memory budget. One thread reads
+   random 4 KiB blocks of a 16 MiB file with a skewed pattern (80% of the
+   reads go to 20% of the blocks) and the run reports the time per read and
+   the cache counters. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define BLOCKS 4096          /* 16 MiB file */
+#define TOTAL 50000          /* Reads per run */
+
+static char path[256];
+
+/* A run with a budget of *arg KiB */
+static void run(void* arg)
+{
+  long kb = *(long*) arg;
+  struct cache_stats cs;
+  char variant[32];
+  unsigned int seed = 1;
+  char* buf = malloc(CACHE_BLOCK);
+  long long t0;
+  int fd, i;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "%ldKiB", kb);
+  mythread_setcache(kb * 1024);
+  mythread_setpolicy("rrfd");
+  fd = open(path, O_RDONLY);
+  t0 = bench_now_ns();
+  for (i = 0; i < TOTAL; i++) {
+    long block = rand_r(&seed) % 10 < 8 ? rand_r(&seed) % (BLOCKS / 5) : rand_r(&seed) % BLOCKS;
+
+    if (read_disk(fd, block * CACHE_BLOCK, buf, CACHE_BLOCK) != CACHE_BLOCK || buf[0] != (char) block) {
+      fprintf(stderr, "bench_cache: bad read of block %ld\n", block);
+      exit(2);
+    }
+  }
+  bench_report("cache_read", variant, bench_now_ns() - t0, TOTAL);
+  mythread_cachestats(&cs);
+  bench_value("cache_hits", variant, 100.0 * cs.hits / (cs.hits + cs.misses), "%");
+  bench_value("cache_evict", variant, cs.evictions, "blocks");
+  fflush(bench_out);
+  exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+  long budgets[] = { 1024, 2048, 4096, 8192, 16384 };
+  const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  char block[CACHE_BLOCK];
+  int failed = 0, i, out;
+
+  snprintf(path, sizeof(path), "%s/bench_cache.XXXXXX", dir);
+  out = mkstemp(path);
+  if (out == -1) {
+    perror("mkstemp");
+    return 1;
+  }
+  for (i = 0; i < BLOCKS; i++) {
+    memset(block, i, CACHE_BLOCK);
+    if (write(out, block, CACHE_BLOCK) != CACHE_BLOCK) {
+      perror("write");
+      return 1;
+    }
+  }
+  close(out);
+
+  for (i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+    char label[64];
+
+    snprintf(label, sizeof(label), "cache_read   %ldKiB", budgets[i]);
+    if (bench_isolated(run, &budgets[i], label) == -1)
+      failed = 1;
+  }
+  unlink(path);
+  return failed;
+}
@@ -0,0 +1,134 @@
+/* Message rate of a producer and a consumer: through an unbuffered
+   channel, where every send switches straight to the waiting consumer,
+   through a buffered channel, and through a bounded buffer built with a
+   mutex and two condition variables, which wakes the other side through
+   the run queue. Also a pipeline of STAGES threads over unbuffered
+   channels. Besides the time per message it prints the context switches
+   per message, from the accounting of mythread_getstats(). */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define MESSAGES 200000L
+#define CAP 64
+#define STAGES 4
+
+enum { UNBUFFERED, BUFFERED, CONDVAR, PIPELINE };
+
+static const char* names[] = { "unbuffered", "buffered", "condvar", "pipeline" };
+
+static struct mychan* chans[STAGES];
+static int kind;
+static long long t0;
+static char variant[32];
+
+/* Bounded buffer of the condvar variant */
+static mythread_mutex_t lock = MYTHREAD_MUTEX_INITIALIZER;
+static mythread_cond_t not_empty = MYTHREAD_COND_INITIALIZER;
+static mythread_cond_t not_full = MYTHREAD_COND_INITIALIZER;
+static long ring[CAP];
+static int head = 0, count = 0;
+
+static void put(long v)
+{
+  mythread_mutex_lock(&lock);
+  while (count == CAP)
+    mythread_cond_wait(&not_full, &lock);
+  ring[(head + count++) % CAP] = v;
+  mythread_cond_signal(&not_empty);
+  mythread_mutex_unlock(&lock);
+}
+
+static long get(void)
+{
+  long v;
+
+  mythread_mutex_lock(&lock);
+  while (count == 0)
+    mythread_cond_wait(&not_empty, &lock);
+  v = ring[head];
+  head = (head + 1) % CAP;
+  count--;
+  mythread_cond_signal(&not_full);
+  mythread_mutex_unlock(&lock);
+  return v;
+}
+
+static void producer(int tid)
+{
+  long i;
+
+  for (i = 1; i <= MESSAGES; i++) {
+    if (kind == CONDVAR)
+      put(i);
+    else
+      mychan_send(chans[0], &i);
+  }
+  mythread_exit();
+}
+
+/* Middle stage of the pipeline: pass every message on */
+static void stage(int tid)
+{
+  int n = mythread_gettid() - 2;
+  long v;
+
+  while (mychan_recv(chans[n], &v) == 0)
+    mychan_send(chans[n + 1], &v);
+}
+
+/* The variant is in kind */
+static void run(void* arg)
+{
+  const char* policy = arg;
+  struct mythread_stats s;
+  int i, last = 0;
+  long v = 0;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "%s/%s", policy, names[kind]);
+  mythread_setpolicy(policy);
+  for (i = 0; i < STAGES; i++)
+    chans[i] = mychan_new(sizeof(long), kind == BUFFERED ? CAP : 0);
+  /* Threads 1 (producer) and 2.. (stages) */
+  mythread_create(producer, LOW_PRIORITY);
+  if (kind == PIPELINE) {
+    for (i = 0; i < STAGES - 1; i++)
+      mythread_create(stage, LOW_PRIORITY);
+    last = STAGES - 1;
+  }
+
+  t0 = bench_now_ns();
+  while (v != MESSAGES) {
+    if (kind == CONDVAR)
+      v = get();
+    else
+      mychan_recv(chans[last], &v);
+  }
+  bench_report("chan", variant, bench_now_ns() - t0, MESSAGES);
+  mythread_getstats(MYTHREAD_ALL, &s);
+  bench_value("chan_switch", variant, (double) s.dispatches / MESSAGES, "switches/msg");
+  fflush(bench_out);
+  exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char** policies = bench_policies();
+  int failed = 0, p;
+
+  for (p = 0; policies[p] != NULL; p++) {
+    for (kind = UNBUFFERED; kind <= PIPELINE; kind++) {
+      char label[64];
+
+      snprintf(label, sizeof(label), "chan         %s/%s", policies[p], names[kind]);
+      if (bench_isolated(run, (void*) policies[p], label) == -1)
+        failed = 1;
+    }
+  }
+  return failed;
+}
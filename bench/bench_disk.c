@@ -0,0 +1,120 @@
+/* Random 4 KiB reads with read_disk() through each disk backend, with a
+   growing number of green threads and so of reads in flight. The file is
+   created in TMPDIR (or /tmp) and is usually in the page cache, so this
+   measures the cost of the asynchronous path rather than the device.
+   Each run also reports how many threads a disk interrupt wakes at once
+   and the delay from the completion of a read to the wake-up. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define BLOCK CACHE_BLOCK
+#define BLOCKS 4096          /* 16 MiB file */
+#define TOTAL 20000          /* Reads per run */
+
+static char path[256];
+static int fd;
+static long issued = 0;
+static long finished = 0;
+static int running_threads;
+static long long t0;
+static char variant[32];
+
+static void reader(int tid)
+{
+  char* buf = malloc(BLOCK);   /* Thread stacks are only STACKSIZE bytes */
+  unsigned int seed = tid;
+
+  while (issued < TOTAL) {
+    long block = rand_r(&seed) % BLOCKS;
+
+    issued++;
+    if (read_disk(fd, block * BLOCK, buf, BLOCK) != BLOCK || buf[0] != (char) block) {
+      fprintf(stderr, "bench_disk: bad read of block %ld\n", block);
+      exit(2);
+    }
+    finished++;
+  }
+  free(buf);
+  if (--running_threads == 0) {
+    struct disk_stats ds;
+
+    bench_report("read_4k", variant, bench_now_ns() - t0, finished);
+    mythread_diskstats(&ds);
+    bench_value("disk_batch", variant, (double) ds.woken / ds.batches, "woken/batch");
+    bench_value("disk_delay", variant, ds.delay_ns / 1e3 / ds.woken, "us avg");
+    bench_value("disk_delay", variant, ds.max_delay_ns / 1e3, "us max");
+    fflush(bench_out);
+    exit(0);
+  }
+  mythread_exit();
+}
+
+struct run_args
+{
+  const char* backend;
+  int threads;
+};
+
+static void run(void* arg)
+{
+  struct run_args* a = arg;
+  const char* backend = a->backend;
+  int threads = a->threads;
+  int i;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "%s/%d", backend, threads);
+  setenv("MYTHREAD_DISK", backend, 1);
+  /* Leave the block cache out of the measure */
+  mythread_setcache(BLOCK);
+  mythread_setpolicy("rrfd");
+  fd = open(path, O_RDONLY);
+  running_threads = threads;
+  t0 = bench_now_ns();
+  for (i = 0; i < threads; i++)
+    mythread_create(reader, LOW_PRIORITY);
+  mythread_exit();
+}
+
+int main(int argc, char *argv[])
+{
+  const char* backends[] = { "io_uring", "pool" };
+  int threads[] = { 1, 8, 64 };
+  const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  char block[BLOCK];
+  int failed = 0, b, i, out;
+
+  snprintf(path, sizeof(path), "%s/bench_disk.XXXXXX", dir);
+  out = mkstemp(path);
+  if (out == -1) {
+    perror("mkstemp");
+    return 1;
+  }
+  for (i = 0; i < BLOCKS; i++) {
+    memset(block, i, BLOCK);
+    if (write(out, block, BLOCK) != BLOCK) {
+      perror("write");
+      return 1;
+    }
+  }
+  close(out);
+
+  for (b = 0; b < 2; b++) {
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+      struct run_args a = { backends[b], threads[i] };
+      char label[64];
+
+      snprintf(label, sizeof(label), "read_4k      %s/%d", backends[b], threads[i]);
+      if (bench_isolated(run, &a, label) == -1)
+        failed = 1;
+    }
+  }
+  unlink(path);
+  return failed;
+}
@@ -0,0 +1,131 @@
+/* Deadlines of periodic request handlers under CPU load. HANDLERS threads
+   each run JOBS jobs of WORK us, one every PERIOD us, that should end
+   within DEADLINE us of their release, next to HOGS threads that never
+   block. The handlers run either in the EDF class, created with
+   mythread_create_deadline() and waiting with mythread_wait_period(), or
+   as HIGH_PRIORITY threads of the policy that sleep until their next
+   release. Each handler checks its own deadlines, so both variants are
+   measured the same way: it prints the share of jobs that missed them and
+   the worst lateness. Also how many reservations of BUDGET us every
+   PERIOD us the admission control accepts. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define HANDLERS 3
+#define HOGS 2
+#define JOBS 50
+#define PERIOD 40000
+#define DEADLINE 20000
+#define WORK 2000
+#define BUDGET 4000
+
+enum { EDF, PRIO };
+
+static const char* names[] = { "edf", "prio" };
+
+static int kind;
+/* First release of each handler, by tid: the handlers are threads 1.. */
+static long long t0[HANDLERS + 1];
+static char variant[32];
+static int done = 0;
+static long misses = 0;
+static long long max_late = 0;
+
+static void handler(int tid)
+{
+  long long release = t0[tid];
+  long long late;
+  int j;
+
+  for (j = 0; j < JOBS; j++) {
+    mythread_compute(WORK);
+    late = bench_now_ns() - (release + DEADLINE * 1000LL);
+    if (late > 0) {
+      misses++;
+      if (late > max_late)
+        max_late = late;
+    }
+    release += PERIOD * 1000LL;
+    if (kind == EDF) {
+      mythread_wait_period();
+    } else {
+      long long wait = release - bench_now_ns();
+
+      if (wait > 0)
+        mythread_sleep(wait / 1000);
+    }
+  }
+  if (++done == HANDLERS) {
+    bench_value("edf_miss", variant, 100.0 * misses / (HANDLERS * JOBS), "% missed");
+    bench_value("edf_late", variant, max_late / 1e6, "ms max lateness");
+    fflush(bench_out);
+    exit(0);
+  }
+  mythread_exit();
+}
+
+static void hog(int tid)
+{
+  for (;;)
+    mythread_compute(1000);
+}
+
+/* The variant is in kind */
+static void run(void* arg)
+{
+  const char* policy = arg;
+  int i;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "%s/%s", policy, names[kind]);
+  mythread_setpolicy(policy);
+  /* The handlers first. The EDF class releases the first job at creation,
+     and a new EDF thread preempts this one */
+  for (i = 0; i < HANDLERS; i++) {
+    t0[i + 1] = bench_now_ns();
+    if (kind == EDF)
+      mythread_create_deadline(handler, PERIOD, BUDGET, DEADLINE);
+    else
+      mythread_create(handler, HIGH_PRIORITY);
+  }
+  for (i = 0; i < HOGS; i++)
+    mythread_create(hog, LOW_PRIORITY);
+  mythread_exit();
+}
+
+/* Reservations accepted until the first one is refused */
+static void admission(void* arg)
+{
+  int n = 0;
+
+  bench_quiet();
+  while (mythread_create_deadline(hog, PERIOD, BUDGET, PERIOD) != -1)
+    n++;
+  bench_value("edf_admit", "reservations", n, "admitted");
+  fflush(bench_out);
+  exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char** policies = bench_policies();
+  int failed = 0, p;
+
+  for (p = 0; policies[p] != NULL; p++) {
+    for (kind = EDF; kind <= PRIO; kind++) {
+      char label[64];
+
+      snprintf(label, sizeof(label), "edf          %s/%s", policies[p], names[kind]);
+      if (bench_isolated(run, (void*) policies[p], label) == -1)
+        failed = 1;
+    }
+  }
+  if (bench_isolated(admission, NULL, "edf_admit    reservations") == -1)
+    failed = 1;
+  return failed;
+}
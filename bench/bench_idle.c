@@ -0,0 +1,96 @@
+/* Wake-up latency from idle: sleeping idle thread (default) against the
+   busy-waiting one (MYTHREAD_IDLE=spin). The only thread blocks in
+   read_disk() and a helper pthread sends the disk signal every PERIOD;
+   the latency is the time from the signal to the thread running again.
+   The CPU time of each run shows what the idle thread costs. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define SAMPLES 300
+#define PERIOD 2000000   /* ns between disk signals */
+
+static atomic_llong sent_at = 0;
+static pthread_t target;
+
+static void* disk_signaller(void* arg)
+{
+  struct timespec ts = { 0, PERIOD };
+
+  while (1) {
+    nanosleep(&ts, NULL);
+    atomic_store(&sent_at, bench_now_ns());
+    pthread_kill(target, SIGPROF);
+  }
+  return NULL;
+}
+
+static void run(void* arg)
+{
+  const char* idle = arg;
+  char variant[32];
+  long long total = 0;
+  struct rusage ru;
+  pthread_t helper;
+  sigset_t set, old;
+  long block = 0;
+  int n = 0;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "idle=%s", idle);
+  setenv("MYTHREAD_IDLE", idle, 1);
+  mythread_setpolicy("rrfd");
+  mythread_gettid();
+
+  /* The signals must reach the thread running the library */
+  target = pthread_self();
+  sigemptyset(&set);
+  sigaddset(&set, SIGPROF);
+  sigaddset(&set, SIGVTALRM);
+  pthread_sigmask(SIG_BLOCK, &set, &old);
+  pthread_create(&helper, NULL, disk_signaller, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  while (n < SAMPLES) {
+    long long before = bench_now_ns();
+    long long after, sent;
+
+    /* A new block every time, so that it is never in the cache */
+    read_disk(DISK_SIM, (off_t) block++ * CACHE_BLOCK, NULL, CACHE_BLOCK);
+    after = bench_now_ns();
+    sent = atomic_load(&sent_at);
+    /* Only count the reads that blocked until a signal sent after them */
+    if (sent > before && after - before > 10000) {
+      total += after - sent;
+      n++;
+    }
+  }
+  bench_report("idle_wakeup", variant, total, SAMPLES);
+  getrusage(RUSAGE_SELF, &ru);
+  bench_value("idle_cpu", variant,
+              ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6, "s cpu");
+  fflush(bench_out);
+  exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char* variants[] = { "sleep", "spin" };
+  int failed = 0, i;
+
+  for (i = 0; i < 2; i++) {
+    char label[64];
+
+    snprintf(label, sizeof(label), "idle_wakeup  idle=%s", variants[i]);
+    if (bench_isolated(run, (void*) variants[i], label) == -1)
+      failed = 1;
+  }
+  return failed;
+}
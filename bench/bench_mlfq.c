@@ -0,0 +1,104 @@
+/* A mixed workload with no priorities assigned: CPU_THREADS threads that
+   only compute, like fun3 of main.c, and IO_THREADS threads that compute
+   IO_WORK us before every read_disk(), like fun1 and fun2. All of them
+   are created with LOW_PRIORITY. It runs in simulation mode, so every run
+   is deterministic and the times are of the virtual clock. For each policy
+   it prints how long an I/O thread waits in the run queue each time it
+   gets the CPU, on average and at most, and the context switches of the
+   whole run. The disk, not the CPU, sets how long it takes, so that is
+   the same for every policy. rr and rrf do not block in
+   read_disk() and are left out. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define CPU_THREADS 4
+#define IO_THREADS 4
+#define CPU_WORK 2000000     /* us of computation of a CPU-bound thread */
+#define IO_ROUNDS 10
+#define IO_WORK 1000         /* us computed before every read */
+
+static int running_threads;
+static struct mythread_stats io;
+static const char* variant;
+
+static void done(void)
+{
+  if (--running_threads == 0) {
+    struct mythread_stats st;
+
+    mythread_getstats(MYTHREAD_ALL, &st);
+    bench_value("mlfq_wait", variant, io.ready_ns / 1e6 / io.dispatches, "ms ready per I/O run");
+    bench_value("mlfq_maxwait", variant, io.max_ready_ns / 1e6, "ms ready at most");
+    bench_value("mlfq_switch", variant, st.dispatches, "switches");
+    fflush(bench_out);
+    exit(0);
+  }
+  mythread_exit();
+}
+
+static void cpu_thread(int tid)
+{
+  int i;
+
+  for (i = 0; i < 100; i++)
+    mythread_compute(CPU_WORK / 100);
+  done();
+}
+
+static void io_thread(int tid)
+{
+  struct mythread_stats st;
+  int i;
+
+  for (i = 0; i < IO_ROUNDS; i++) {
+    mythread_compute(IO_WORK);
+    read_disk(DISK_SIM, (off_t) (tid * IO_ROUNDS + i) * CACHE_BLOCK, NULL, CACHE_BLOCK);
+  }
+  /* A finished thread has no accounting of its own any more */
+  mythread_getstats(mythread_gettid(), &st);
+  io.ready_ns += st.ready_ns;
+  io.dispatches += st.dispatches;
+  if (st.max_ready_ns > io.max_ready_ns)
+    io.max_ready_ns = st.max_ready_ns;
+  done();
+}
+
+static void run(void* arg)
+{
+  const char* policy = arg;
+  int i;
+
+  bench_quiet();
+  variant = policy;
+  mythread_setsim(1);
+  mythread_setpolicy(policy);
+  running_threads = CPU_THREADS + IO_THREADS;
+  /* The CPU-bound threads first, so they are running when the I/O starts */
+  for (i = 0; i < CPU_THREADS; i++)
+    mythread_create(cpu_thread, LOW_PRIORITY);
+  for (i = 0; i < IO_THREADS; i++)
+    mythread_create(io_thread, LOW_PRIORITY);
+  mythread_exit();
+}
+
+int main(int argc, char *argv[])
+{
+  const char** policies = bench_policies();
+  int failed = 0, p;
+
+  for (p = 0; policies[p] != NULL; p++) {
+    char label[64];
+
+    if (strcmp(policies[p], "rr") == 0 || strcmp(policies[p], "rrf") == 0)
+      continue;
+    snprintf(label, sizeof(label), "mlfq         %s", policies[p]);
+    if (bench_isolated(run, (void*) policies[p], label) == -1)
+      failed = 1;
+  }
+  return failed;
+}
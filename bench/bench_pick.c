@@ -0,0 +1,59 @@
+/* Cost of a scheduling decision as the run queue grows: each sample takes
+   the next thread from the policy and queues it again, the work done at
+   every switch. The TCBs are fake and the library is not started, so only
+   the run queue code of each policy is measured. */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mythread.h"
+#include "sched.h"
+#include "bench.h"
+
+#define SAMPLES 200000L
+
+static unsigned long long samples[SAMPLES];
+
+static void run(struct sched_policy* p, long length)
+{
+  char variant[32];
+  TCB* tcbs = calloc(length, sizeof(TCB));
+  long i;
+
+  snprintf(variant, sizeof(variant), "%s/len=%ld", p->name, length);
+  p->init();
+  /* One in four threads at high priority, for the policies that use it */
+  for (i = 0; i < length; i++) {
+    tcbs[i].tid = i;
+    tcbs[i].state = INIT;
+    tcbs[i].priority = i % 4 == 0 ? HIGH_PRIORITY : LOW_PRIORITY;
+    tcbs[i].ticks = QUANTUM_TICKS;
+    tcbs[i].weight = DEFAULT_WEIGHT;
+    p->enqueue(&tcbs[i]);
+  }
+  for (i = 0; i < SAMPLES; i++) {
+    unsigned long long c0 = bench_cycles();
+    TCB* t = p->pick_next();
+
+    p->enqueue(t);
+    samples[i] = bench_cycles() - c0;
+  }
+  bench_percentiles("pick", variant, samples, SAMPLES);
+  /* Leave the run queue empty for the next length */
+  while (p->pick_next() != NULL);
+  free(tcbs);
+}
+
+int main(int argc, char *argv[])
+{
+  struct sched_policy* policies[] = { &sched_rr, &sched_rrf, &sched_rrfd, &sched_cfs, &sched_mlfq };
+  const char** names = bench_policies();
+  long lengths[] = { 1, 10, 100, 1000, 10000 };
+  int i, j, n;
+
+  for (n = 0; names[n] != NULL; n++)
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+      if (strcmp(policies[i]->name, names[n]) == 0)
+        for (j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++)
+          run(policies[i], lengths[j]);
+  return 0;
+}
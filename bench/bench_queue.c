@@ -0,0 +1,78 @@
+/* Run queue cost per context switch: the activator enqueues the outgoing
+   thread and the scheduler dequeues the next one. Compares the original
+   malloc/free node queue, the pooled struct queue wrapper and the
+   intrusive queue linked through the TCB. */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define SWITCHES 10000000L
+#define N 10
+
+/* The original queue.c: one malloc() per enqueue and one free() per dequeue */
+static void legacy_enqueue(struct queue* s, void* data)
+{
+  struct my_struct* p = malloc(sizeof(struct my_struct));
+  p->data = data;
+  p->next = NULL;
+  if (s->head == NULL)
+    s->head = p;
+  else
+    s->tail->next = p;
+  s->tail = p;
+}
+
+static void* legacy_dequeue(struct queue* s)
+{
+  struct my_struct* h = s->head;
+  void* ret = h->data;
+  s->head = h->next;
+  if (s->head == NULL) s->tail = NULL;
+  free(h);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  static TCB threads[N];
+  struct queue legacy = { NULL, NULL };
+  struct queue* pooled = queue_new();
+  struct iqueue intrusive;
+  TCB* running;
+  long long t0;
+  long i;
+
+  iqueue_init(&intrusive);
+  for (i = 0; i < N; i++) {
+    threads[i].tid = i;
+    legacy_enqueue(&legacy, &threads[i]);
+    enqueue(pooled, &threads[i]);
+    tcb_enqueue(&intrusive, &threads[i]);
+  }
+
+  running = &threads[0];
+  t0 = bench_now_ns();
+  for (i = 0; i < SWITCHES; i++) {
+    legacy_enqueue(&legacy, running);
+    running = legacy_dequeue(&legacy);
+  }
+  bench_report("queue", "malloc", bench_now_ns() - t0, SWITCHES);
+
+  t0 = bench_now_ns();
+  for (i = 0; i < SWITCHES; i++) {
+    enqueue(pooled, running);
+    running = dequeue(pooled);
+  }
+  bench_report("queue", "pool", bench_now_ns() - t0, SWITCHES);
+
+  t0 = bench_now_ns();
+  for (i = 0; i < SWITCHES; i++) {
+    tcb_enqueue(&intrusive, running);
+    running = tcb_dequeue(&intrusive);
+  }
+  bench_report("queue", "intrusive", bench_now_ns() - t0, SWITCHES);
+
+  return running->tid < 0;
+}
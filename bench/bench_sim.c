@@ -0,0 +1,140 @@
+/* Deterministic simulation: a scenario of CPU-bound threads and threads
+   that alternate short computations with disk reads, run twice with every
+   single-worker policy in simulation mode. Each run reports the virtual
+   time the scenario takes, the wall time to simulate it, and whether both
+   runs logged the same events in the same order. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define CPU_THREADS 4
+#define IO_THREADS 4
+#define CPU_WORK 2000000     /* us of computation of a CPU-bound thread */
+#define IO_ROUNDS 5
+#define IO_WORK 2000         /* us computed between two reads */
+
+static int running_threads;
+static long long t0;
+static int wfd;
+static char log_path[256];
+
+static void done(void)
+{
+  if (--running_threads == 0) {
+    struct mythread_stats st;
+    long long result[3];
+
+    mythread_getstats(MYTHREAD_ALL, &st);
+    /* One worker: it was either running a thread or idle */
+    result[0] = st.run_ns + mythread_idletime();
+    result[1] = bench_now_ns() - t0;
+    result[2] = st.ready_ns;
+    if (write(wfd, result, sizeof(result)) != sizeof(result))
+      exit(2);
+    fflush(stdout);
+    exit(0);
+  }
+  mythread_exit();
+}
+
+static void cpu_thread(int tid)
+{
+  int i;
+
+  for (i = 0; i < 100; i++)
+    mythread_compute(CPU_WORK / 100);
+  done();
+}
+
+static void io_thread(int tid)
+{
+  int i;
+
+  for (i = 0; i < IO_ROUNDS; i++) {
+    mythread_compute(IO_WORK);
+    read_disk(DISK_SIM, (off_t) (tid * IO_ROUNDS + i) * CACHE_BLOCK, NULL, CACHE_BLOCK);
+  }
+  done();
+}
+
+/* Log the events to log_path and write the results to wfd */
+static void run(void* arg)
+{
+  const char* policy = arg;
+  int i;
+
+  if (freopen(log_path, "w", stdout) == NULL)
+    exit(2);
+  mythread_setsim(1);
+  mythread_setpolicy(policy);
+  running_threads = CPU_THREADS + IO_THREADS;
+  t0 = bench_now_ns();
+  for (i = 0; i < CPU_THREADS; i++)
+    mythread_create(cpu_thread, LOW_PRIORITY);
+  for (i = 0; i < IO_THREADS; i++)
+    mythread_create(io_thread, HIGH_PRIORITY);
+  mythread_exit();
+}
+
+/* FNV-1a hash of a file */
+static unsigned long long hash_file(const char* path)
+{
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  FILE* f = fopen(path, "r");
+  int c;
+
+  if (f == NULL)
+    return 0;
+  while ((c = getc(f)) != EOF)
+    h = (h ^ (unsigned char) c) * 0x100000001b3ULL;
+  fclose(f);
+  return h;
+}
+
+int main(int argc, char *argv[])
+{
+  const char** policies = bench_policies();
+  const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  int failed = 0, p, r;
+
+  snprintf(log_path, sizeof(log_path), "%s/bench_sim.%d", dir, (int) getpid());
+  for (p = 0; policies[p] != NULL; p++) {
+    unsigned long long hash[2];
+    long long result[2][3];
+    char variant[32];
+
+    for (r = 0; r < 2; r++) {
+      char label[64];
+      int fds[2];
+
+      if (pipe(fds) == -1) {
+        perror("pipe");
+        return 1;
+      }
+      /* The results fit in the pipe: they are read once the child is done */
+      wfd = fds[1];
+      snprintf(label, sizeof(label), "sim          %s", policies[p]);
+      if (bench_isolated(run, (void*) policies[p], label) == -1) {
+        failed = 1;
+        hash[r] = r;
+      } else {
+        hash[r] = hash_file(log_path);
+      }
+      close(fds[1]);
+      if (read(fds[0], result[r], sizeof(result[r])) != sizeof(result[r]))
+        memset(result[r], 0, sizeof(result[r]));
+      close(fds[0]);
+    }
+    snprintf(variant, sizeof(variant), "%s", policies[p]);
+    bench_value("sim_virtual", variant, result[0][0] / 1e6, "ms simulated");
+    bench_value("sim_wall", variant, result[0][1] / 1e6, "ms to simulate");
+    bench_value("sim_ready", variant, result[0][2] / 1e6, "ms ready");
+    bench_value("sim_same", variant, hash[0] == hash[1] && result[0][0] == result[1][0], "identical runs");
+  }
+  unlink(log_path);
+  return failed;
+}
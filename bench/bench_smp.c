@@ -0,0 +1,67 @@
+/* Throughput of CPU-bound green threads in M:N mode, from 1 to nproc
+   workers. JOBS threads spin for WORK iterations each and exit; the time
+   per job should drop with the number of workers up to the number of
+   cores. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define JOBS 2000
+#define WORK 500000
+
+static atomic_long finished = 0;
+static long long t0;
+static char variant[32];
+
+static void job(int tid)
+{
+  volatile long i;
+
+  for (i = 0; i < WORK; i++);
+  if (atomic_fetch_add(&finished, 1) + 1 == JOBS) {
+    bench_report("smp_jobs", variant, bench_now_ns() - t0, JOBS);
+    fflush(bench_out);
+    exit(0);
+  }
+  mythread_exit();
+}
+
+static void run(void* arg)
+{
+  int nworkers = *(int*) arg;
+  int i;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "workers=%d", nworkers);
+  mythread_setworkers(nworkers);
+  mythread_setpolicy("ws");
+  t0 = bench_now_ns();
+  for (i = 0; i < JOBS; i++) {
+    if (mythread_create(job, LOW_PRIORITY) == -1) {
+      fprintf(stderr, "bench_smp: mythread_create failed\n");
+      exit(2);
+    }
+  }
+  mythread_exit();
+}
+
+int main(int argc, char *argv[])
+{
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int failed = 0, n;
+
+  if (ncpu < 1)
+    ncpu = 1;
+  for (n = 1; n <= ncpu; n++) {
+    char label[64];
+
+    snprintf(label, sizeof(label), "smp_jobs     workers=%d", n);
+    if (bench_isolated(run, &n, label) == -1)
+      failed = 1;
+  }
+  return failed;
+}
@@ -0,0 +1,79 @@
+/* Ping-pong context switch latency: two contexts switch back and forth.
+   Compares the assembly switch of context.c with swapcontext(), which
+   also saves the whole ucontext_t and the signal mask (a system call).
+   The distribution is of single round trips (two switches). */
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include "context.h"
+#include "stack.h"
+#include "bench.h"
+
+#define ROUNDS 1000000L
+#define SAMPLES 100000L
+#define STACK 65536
+
+static unsigned long long samples[SAMPLES];
+
+static struct context main_ctx, peer_ctx;
+static ucontext_t main_uc, peer_uc;
+
+static void peer(void)
+{
+  for (;;)
+    ctx_switch(&peer_ctx, &main_ctx);
+}
+
+static void peer_uc_body(void)
+{
+  for (;;)
+    swapcontext(&peer_uc, &main_uc);
+}
+
+/* Time SAMPLES round trips one by one */
+static void round_trips(const char* variant, int uc)
+{
+  long i;
+
+  for (i = 0; i < SAMPLES; i++) {
+    unsigned long long c0 = bench_cycles();
+
+    if (uc)
+      swapcontext(&main_uc, &peer_uc);
+    else
+      ctx_switch(&main_ctx, &peer_ctx);
+    samples[i] = bench_cycles() - c0;
+  }
+  bench_percentiles("switch_rt", variant, samples, SAMPLES);
+}
+
+int main(int argc, char *argv[])
+{
+  long long t0;
+  long i;
+
+  ctx_make(&peer_ctx, stack_alloc(STACK), STACK, peer);
+  t0 = bench_now_ns();
+  for (i = 0; i < ROUNDS; i++)
+    ctx_switch(&main_ctx, &peer_ctx);
+#ifdef CTX_ASM
+  bench_report("switch", "asm", bench_now_ns() - t0, 2 * ROUNDS);
+  round_trips("asm", 0);
+#else
+  bench_report("switch", "ctx_ucontext", bench_now_ns() - t0, 2 * ROUNDS);
+  round_trips("ctx_ucontext", 0);
+#endif
+
+  getcontext(&peer_uc);
+  peer_uc.uc_stack.ss_sp = stack_alloc(STACK);
+  peer_uc.uc_stack.ss_size = STACK;
+  peer_uc.uc_link = NULL;
+  makecontext(&peer_uc, peer_uc_body, 0);
+  t0 = bench_now_ns();
+  for (i = 0; i < ROUNDS; i++)
+    swapcontext(&main_uc, &peer_uc);
+  bench_report("switch", "ucontext", bench_now_ns() - t0, 2 * ROUNDS);
+  round_trips("ucontext", 1);
+  return 0;
+}
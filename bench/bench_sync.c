@@ -0,0 +1,117 @@
+/* Contention on a critical section. THREADS threads each enter it ROUNDS
+   times; inside they read a shared counter, compute for a while and write
+   it back incremented, so a lost update shows that the section was not
+   exclusive. The clock interrupt preempts threads inside it, and the
+   others then contend for it. Compares the mutex and the semaphore of
+   sync.h with blocking the signals around the section with sigprocmask()
+   (two system calls per section) and with disable_interrupt(), which
+   does no system call. The mutex and the semaphore also run on several
+   workers (M:N), where blocking the signals protects nothing. A run with
+   a lost update never reaches the final count and fails. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define THREADS 8
+#define ROUNDS 100000
+#define WORK 50
+
+enum { MUTEX, SEM, SIGPROCMASK, PREEMPT };
+
+static const char* names[] = { "mutex", "sem", "sigprocmask", "preempt" };
+
+static mythread_mutex_t mutex = MYTHREAD_MUTEX_INITIALIZER;
+static mythread_sem_t sem;
+static sigset_t signals;
+static volatile long counter = 0;
+static int kind;
+static long long t0;
+static char variant[32];
+
+static void enter(void)
+{
+  switch (kind) {
+  case MUTEX: mythread_mutex_lock(&mutex); break;
+  case SEM: mythread_sem_wait(&sem); break;
+  case SIGPROCMASK: sigprocmask(SIG_BLOCK, &signals, NULL); break;
+  case PREEMPT: disable_interrupt(); break;
+  }
+}
+
+static void leave(void)
+{
+  switch (kind) {
+  case MUTEX: mythread_mutex_unlock(&mutex); break;
+  case SEM: mythread_sem_post(&sem); break;
+  case SIGPROCMASK: sigprocmask(SIG_UNBLOCK, &signals, NULL); break;
+  case PREEMPT: enable_interrupt(); break;
+  }
+}
+
+static void worker(int tid)
+{
+  volatile long i;
+  long r, c;
+
+  for (r = 0; r < ROUNDS; r++) {
+    enter();
+    c = counter;
+    for (i = 0; i < WORK; i++);
+    counter = c + 1;
+    if (c + 1 == (long) THREADS * ROUNDS) {
+      bench_report("sync", variant, bench_now_ns() - t0, (long) THREADS * ROUNDS);
+      fflush(bench_out);
+      exit(0);
+    }
+    leave();
+  }
+  mythread_exit();
+}
+
+/* The variant is in kind, the number of workers in *arg */
+static void run(void* arg)
+{
+  int nworkers = *(int*) arg;
+  int i;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "%s/w=%d", names[kind], nworkers);
+  if (nworkers > 1) {
+    mythread_setworkers(nworkers);
+    mythread_setpolicy("ws");
+  }
+  mythread_sem_init(&sem, 1);
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGVTALRM);
+  sigaddset(&signals, SIGPROF);
+  sigaddset(&signals, SIGIO);
+  t0 = bench_now_ns();
+  for (i = 0; i < THREADS; i++)
+    mythread_create(worker, LOW_PRIORITY);
+  mythread_exit();
+}
+
+static int variant_of(int k, int nworkers)
+{
+  char label[64];
+
+  kind = k;
+  snprintf(label, sizeof(label), "sync         %s/w=%d", names[k], nworkers);
+  return bench_isolated(run, &nworkers, label);
+}
+
+int main(int argc, char *argv[])
+{
+  int failed = 0, k;
+
+  for (k = MUTEX; k <= PREEMPT; k++)
+    failed |= variant_of(k, 1) == -1;
+  failed |= variant_of(MUTEX, 4) == -1;
+  failed |= variant_of(SEM, 4) == -1;
+  return failed;
+}
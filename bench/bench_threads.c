@@ -0,0 +1,76 @@
+/* Thread create/exit throughput as the number of live threads grows.
+   Each run keeps a population of live threads and creates and destroys
+   TOTAL threads: every thread creates its successor and exits. With O(1)
+   TCB allocation the cost per thread should stay flat for any population.
+   It runs with every single-worker policy, or only MYTHREAD_POLICY if set. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define TOTAL 100000
+
+static long created = 0;
+static long finished = 0;
+static long long t0;
+static char variant[32];
+
+struct run_args
+{
+  const char* policy;
+  long population;
+};
+
+static void worker(int tid)
+{
+  if (created < TOTAL) {
+    created++;
+    if (mythread_create(worker, LOW_PRIORITY) == -1) {
+      fprintf(stderr, "bench_threads: mythread_create failed\n");
+      exit(2);
+    }
+  }
+  if (++finished == TOTAL) {
+    bench_report("create_exit", variant, bench_now_ns() - t0, TOTAL);
+    fflush(bench_out);
+    exit(0);
+  }
+  mythread_exit();
+}
+
+static void run(void* arg)
+{
+  struct run_args* a = arg;
+  long i;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "%s/live=%ld", a->policy, a->population);
+  mythread_setpolicy(a->policy);
+  t0 = bench_now_ns();
+  for (i = 0; i < a->population; i++) {
+    created++;
+    mythread_create(worker, LOW_PRIORITY);
+  }
+  mythread_exit();
+}
+
+int main(int argc, char *argv[])
+{
+  long populations[] = { 1, 100, 1000, 10000 };
+  const char** policies = bench_policies();
+  int failed = 0, i, p;
+
+  for (p = 0; policies[p] != NULL; p++) {
+    for (i = 0; i < sizeof(populations) / sizeof(populations[0]); i++) {
+      struct run_args a = { policies[p], populations[i] };
+      char label[64];
+
+      snprintf(label, sizeof(label), "create_exit  %s/live=%ld", policies[p], populations[i]);
+      if (bench_isolated(run, &a, label) == -1)
+        failed = 1;
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,111 @@
+/* Wake-up latency from the disk interrupt to the first run of the woken
+   thread, with CPU-bound threads competing for the CPU. The measuring
+   thread runs at high priority and blocks in read_disk(); a helper pthread
+   sends the disk signal every PERIOD, and each sample is the time from the
+   signal to the thread running again. Only the policies that block on the
+   disk apply. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define SAMPLES 300
+#define PERIOD 2000000   /* ns between disk signals */
+
+static unsigned long long samples[SAMPLES];
+static atomic_ullong sent_at = 0;
+static pthread_t target;
+
+static void* disk_signaller(void* arg)
+{
+  struct timespec ts = { 0, PERIOD };
+
+  while (1) {
+    nanosleep(&ts, NULL);
+    atomic_store(&sent_at, bench_cycles());
+    pthread_kill(target, SIGPROF);
+  }
+  return NULL;
+}
+
+static void spinner(int tid)
+{
+  for (;;);
+}
+
+struct run_args
+{
+  const char* policy;
+  int spinners;
+};
+
+static void run(void* arg)
+{
+  struct run_args* a = arg;
+  const char* policy = a->policy;
+  int spinners = a->spinners;
+  long min_block = 10000 * bench_cycles_per_ns();
+  char variant[32];
+  pthread_t helper;
+  sigset_t set, old;
+  long block = 0;
+  int i, n = 0;
+
+  bench_quiet();
+  snprintf(variant, sizeof(variant), "%s/spin=%d", policy, spinners);
+  mythread_setpolicy(policy);
+  mythread_setpriority(HIGH_PRIORITY);
+  for (i = 0; i < spinners; i++)
+    mythread_create(spinner, LOW_PRIORITY);
+
+  /* The signals must reach the thread running the library */
+  target = pthread_self();
+  sigemptyset(&set);
+  sigaddset(&set, SIGPROF);
+  sigaddset(&set, SIGVTALRM);
+  pthread_sigmask(SIG_BLOCK, &set, &old);
+  pthread_create(&helper, NULL, disk_signaller, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  while (n < SAMPLES) {
+    unsigned long long before = bench_cycles();
+    unsigned long long after, sent;
+
+    /* A new block every time, so that it is never in the cache */
+    read_disk(DISK_SIM, (off_t) block++ * CACHE_BLOCK, NULL, CACHE_BLOCK);
+    after = bench_cycles();
+    sent = atomic_load(&sent_at);
+    /* Only count the reads that blocked until a signal sent after them */
+    if (sent > before && after - before > min_block)
+      samples[n++] = after - sent;
+  }
+  bench_percentiles("wakeup", variant, samples, SAMPLES);
+  fflush(bench_out);
+  exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char** policies = bench_policies();
+  int spinners[] = { 0, 4 };
+  int failed = 0, i, p;
+
+  for (p = 0; policies[p] != NULL; p++) {
+    if (strcmp(policies[p], "rrfd") != 0)
+      continue;
+    for (i = 0; i < sizeof(spinners) / sizeof(spinners[0]); i++) {
+      struct run_args a = { policies[p], spinners[i] };
+      char label[64];
+
+      snprintf(label, sizeof(label), "wakeup       %s/spin=%d", policies[p], spinners[i]);
+      if (bench_isolated(run, &a, label) == -1)
+        failed = 1;
+    }
+  }
+  return failed;
+}
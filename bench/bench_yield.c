@@ -0,0 +1,69 @@
+/* mythread_yield() and mythread_sleep(). Two threads of the same priority
+   yield to each other: each sample is one round trip (two yields and two
+   switches). Then a thread sleeps again and again, and each sample is how
+   late it wakes up; sleeps end at a clock tick, so this is at most a tick
+   plus the wake-up latency. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mythread.h"
+#include "bench.h"
+
+#define SAMPLES 100000L
+#define SLEEPS 50
+#define SLEEP_US 3000
+
+static unsigned long long samples[SAMPLES];
+
+static void peer(int tid)
+{
+  for (;;)
+    mythread_yield();
+}
+
+static void run(void* arg)
+{
+  const char* policy = arg;
+  char variant[32];
+  long i;
+
+  bench_quiet();
+  mythread_setpolicy(policy);
+  mythread_create(peer, LOW_PRIORITY);
+  for (i = 0; i < SAMPLES; i++) {
+    unsigned long long c0 = bench_cycles();
+
+    mythread_yield();
+    samples[i] = bench_cycles() - c0;
+  }
+  bench_percentiles("yield_rt", policy, samples, SAMPLES);
+
+  /* The peer would take the CPU whenever the sleeper is ready */
+  mythread_setpriority(HIGH_PRIORITY);
+  for (i = 0; i < SLEEPS; i++) {
+    unsigned long long c0 = bench_cycles();
+
+    mythread_sleep(SLEEP_US);
+    samples[i] = bench_cycles() - c0 - (unsigned long long) (SLEEP_US * 1000 * bench_cycles_per_ns());
+  }
+  snprintf(variant, sizeof(variant), "%s/late", policy);
+  bench_percentiles("sleep", variant, samples, SLEEPS);
+  fflush(bench_out);
+  exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char** policies = bench_policies();
+  int failed = 0, p;
+
+  for (p = 0; policies[p] != NULL; p++) {
+    char label[64];
+
+    snprintf(label, sizeof(label), "yield        %s", policies[p]);
+    if (bench_isolated(run, (void*) policies[p], label) == -1)
+      failed = 1;
+  }
+  return failed;
+}
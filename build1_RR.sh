@@ -2,8 +2,8 @@
 
 # Compilando y Ejecutando 3.1 (RR)
 
-make rr
+make
 
-./main
+MYTHREAD_POLICY=rr ./main
 
 
@@ -2,8 +2,8 @@
 
 # Compilando y Ejecutando 3.2 (RRF)
 
-make rrf
+make
 
-./main
+MYTHREAD_POLICY=rrf ./main
 
 
@@ -2,8 +2,8 @@
 
 # Compilando y Ejecutando 3.3 (RRFD)
 
-make rrfd
+make
 
-./main
+MYTHREAD_POLICY=rrfd ./main
 
 
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "cache.h"
+#include "interrupt.h"
+#include "spinlock.h"
+
+/* A frame holds one block. Frames with the same hash are chained through
+   their index, and the CLOCK hand sweeps the frame array: a frame used
+   since the last sweep gets a second chance */
+struct frame
+{
+  dev_t dev;
+  ino_t ino;
+  long block;
+  int next;          /* Next frame in the hash chain, -1 at the end */
+  char used;         /* Holds a block */
+  char ref;          /* Read since the hand last passed */
+};
+
+static struct frame* frames = NULL;
+static char* data = NULL;
+static int* buckets = NULL;
+static long nframes = 0;
+static long nbuckets = 0;
+static long hand = 0;
+static struct cache_stats stats;
+/* Called from threads on every worker */
+static spinlock_t cache_lock = SPINLOCK_INIT;
+
+static long hash(dev_t dev, ino_t ino, long b)
+{
+  unsigned long long h = (unsigned long long) dev * 0x9e3779b97f4a7c15ULL;
+
+  h ^= ino + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  h ^= b + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  return h & (nbuckets - 1);
+}
+
+static int find(dev_t dev, ino_t ino, long b)
+{
+  int i;
+
+  for (i = buckets[hash(dev, ino, b)]; i != -1; i = frames[i].next)
+    if (frames[i].block == b && frames[i].ino == ino && frames[i].dev == dev)
+      return i;
+  return -1;
+}
+
+static void unlink_frame(int f)
+{
+  int* p = &buckets[hash(frames[f].dev, frames[f].ino, frames[f].block)];
+
+  while (*p != f)
+    p = &frames[*p].next;
+  *p = frames[f].next;
+}
+
+/* Take a frame with the CLOCK algorithm, evicting its block if needed */
+static int victim()
+{
+  while (1) {
+    struct frame* f = &frames[hand];
+    int i = hand;
+
+    hand = (hand + 1) % nframes;
+    if (!f->used)
+      return i;
+    if (f->ref) {
+      f->ref = 0;
+      continue;
+    }
+    unlink_frame(i);
+    f->used = 0;
+    stats.evictions++;
+    return i;
+  }
+}
+
+int cache_init(long bytes)
+{
+  long i;
+
+  nframes = bytes / CACHE_BLOCK;
+  if (nframes < 1)
+    nframes = 1;
+  for (nbuckets = 1; nbuckets < nframes; nbuckets <<= 1);
+  frames = calloc(nframes, sizeof(struct frame));
+  buckets = malloc(nbuckets * sizeof(int));
+  /* Pages of the blocks are only touched when they are filled */
+  data = mmap(NULL, nframes * CACHE_BLOCK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (frames == NULL || buckets == NULL || data == MAP_FAILED)
+    return -1;
+  for (i = 0; i < nbuckets; i++)
+    buckets[i] = -1;
+  stats.blocks = nframes;
+  return 0;
+}
+
+int cache_read(dev_t dev, ino_t ino, long b, size_t off, void* dst, size_t n)
+{
+  int f;
+
+  preempt_disable();
+  spin_lock(&cache_lock);
+  f = find(dev, ino, b);
+  if (f == -1) {
+    stats.misses++;
+  } else {
+    stats.hits++;
+    frames[f].ref = 1;
+    if (dst != NULL)
+      memcpy(dst, data + (long) f * CACHE_BLOCK + off, n);
+  }
+  spin_unlock(&cache_lock);
+  preempt_enable();
+  return f != -1;
+}
+
+void cache_miss(long n)
+{
+  preempt_disable();
+  spin_lock(&cache_lock);
+  stats.misses += n;
+  spin_unlock(&cache_lock);
+  preempt_enable();
+}
+
+void cache_insert(dev_t dev, ino_t ino, long b, const void* src)
+{
+  long h;
+  int f;
+
+  preempt_disable();
+  spin_lock(&cache_lock);
+  f = find(dev, ino, b);
+  if (f == -1) {
+    f = victim();
+    frames[f].dev = dev;
+    frames[f].ino = ino;
+    frames[f].block = b;
+    frames[f].used = 1;
+    h = hash(dev, ino, b);
+    frames[f].next = buckets[h];
+    buckets[h] = f;
+  }
+  frames[f].ref = 1;
+  if (src != NULL)
+    memcpy(data + (long) f * CACHE_BLOCK, src, CACHE_BLOCK);
+  spin_unlock(&cache_lock);
+  preempt_enable();
+}
+
+void cache_get_stats(struct cache_stats* s)
+{
+  preempt_disable();
+  spin_lock(&cache_lock);
+  *s = stats;
+  spin_unlock(&cache_lock);
+  preempt_enable();
+}
@@ -0,0 +1,34 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <sys/types.h>
+
+/* Block cache of read_disk(), keyed by (device, inode, block number) with
+   CLOCK eviction. Simulated reads (DISK_SIM) use device and inode 0 and
+   keep no data. */
+
+#define CACHE_BLOCK 4096
+/* Default memory budget (MYTHREAD_CACHE_KB, mythread_setcache()) */
+#define CACHE_SIZE (4 * 1024 * 1024)
+
+struct cache_stats
+{
+  long hits;        /* Blocks found in the cache */
+  long misses;      /* Blocks read from the disk */
+  long evictions;   /* Blocks dropped to make room */
+  long blocks;      /* Capacity in blocks */
+};
+
+/* Reserve bytes of memory for the cache. Returns -1 if there is no memory */
+int cache_init(long bytes);
+/* Copy n bytes at off of block b of the file to dst (if not NULL).
+   Returns 1 on a hit and 0 on a miss */
+int cache_read(dev_t dev, ino_t ino, long b, size_t off, void* dst, size_t n);
+/* Count n blocks read from the disk without looking them up: read_disk()
+   reads whole the blocks after the first miss */
+void cache_miss(long n);
+/* Store block b of the file, CACHE_BLOCK bytes at src (NULL: no data) */
+void cache_insert(dev_t dev, ino_t ino, long b, const void* src);
+void cache_get_stats(struct cache_stats* s);
+
+#endif
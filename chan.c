@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mythread.h"
+#include "sched.h"
+
+/* See chan.h. Every operation is a mychan_select(): a send or a receive
+   is a select of one case. The channels of a select are locked together,
+   in the order of their addresses, and only with the interrupts disabled.
+   A blocked select has one waiter queued on the channel of each case;
+   the thread that completes one of them claims the select first, so a
+   select is done at most once, and the other waiters are removed by the
+   selecting thread when it wakes up. */
+
+/* The operation of a case cannot be done yet */
+#define NOT_READY 1
+
+/* A thread waiting in one case of a select */
+struct chan_waiter
+{
+  struct queue_link link;  /* In the senders or receivers of the channel */
+  struct chan_sel* sel;
+  int idx;                 /* Case */
+};
+
+/* A select of the calling thread. It lives on the stack of the thread */
+struct chan_sel
+{
+  TCB* t;
+  struct mychan_case* cases;
+  int n;
+  struct mychan* order[MYCHAN_MAX_CASES]; /* Distinct channels, in lock order */
+  int nlocks;
+  struct chan_waiter w[MYCHAN_MAX_CASES];
+  int queued;              /* The waiters are in the channels */
+  atomic_int fired;        /* Claimed by the thread that completes a case */
+  int which;               /* Case done, -1 if none yet */
+};
+
+struct mychan* mychan_new(size_t size, int cap)
+{
+  struct mychan* ch;
+
+  if (cap < 0)
+    return NULL;
+  ch = malloc(sizeof(struct mychan));
+  if (ch == NULL)
+    return NULL;
+  ch->buf = cap > 0 ? malloc(size * cap) : NULL;
+  if (cap > 0 && ch->buf == NULL) {
+    free(ch);
+    return NULL;
+  }
+  atomic_flag_clear(&ch->lock.flag);
+  ch->size = size;
+  ch->cap = cap;
+  ch->count = 0;
+  ch->head = 0;
+  ch->closed = 0;
+  iqueue_init(&ch->senders);
+  iqueue_init(&ch->receivers);
+  return ch;
+}
+
+void mychan_free(struct mychan* ch)
+{
+  free(ch->buf);
+  free(ch);
+}
+
+static void* slot(struct mychan* ch, int i)
+{
+  return ch->buf + (size_t) (i % ch->cap) * ch->size;
+}
+
+static void lock_all(struct chan_sel* s)
+{
+  int i;
+
+  for (i = 0; i < s->nlocks; i++)
+    spin_lock(&s->order[i]->lock);
+}
+
+static void unlock_all(struct chan_sel* s)
+{
+  int i;
+
+  for (i = s->nlocks - 1; i >= 0; i--)
+    spin_unlock(&s->order[i]->lock);
+}
+
+/* Take the first waiter of q whose select is not done, and claim it.
+   Waiters of selects done by another case are dropped. Called with the
+   channel locked */
+static struct chan_waiter* claim(struct iqueue* q)
+{
+  struct queue_link* l;
+
+  while ((l = iqueue_pop(q)) != NULL) {
+    struct chan_waiter* w = queue_entry(l, struct chan_waiter, link);
+    int zero = 0;
+
+    if (atomic_compare_exchange_strong(&w->sel->fired, &zero, 1))
+      return w;
+  }
+  return NULL;
+}
+
+/* Complete the case of a claimed waiter with result ok and return its thread */
+static TCB* complete(struct chan_waiter* w, int ok)
+{
+  w->sel->cases[w->idx].ok = ok;
+  w->sel->which = w->idx;
+  return w->sel->t;
+}
+
+static int try_send(struct mychan* ch, void* val, TCB** wake, int* direct)
+{
+  struct chan_waiter* w;
+
+  if (ch->closed)
+    return -1;
+  w = claim(&ch->receivers);
+  if (w != NULL) {
+    void* dst = w->sel->cases[w->idx].val;
+
+    if (dst != NULL)
+      memcpy(dst, val, ch->size);
+    *wake = complete(w, 0);
+    /* On a buffered channel the sender goes on filling the buffer */
+    *direct = ch->cap == 0;
+    return 0;
+  }
+  if (ch->count < ch->cap) {
+    memcpy(slot(ch, ch->head + ch->count), val, ch->size);
+    ch->count++;
+    return 0;
+  }
+  return NOT_READY;
+}
+
+static int try_recv(struct mychan* ch, void* val, TCB** wake)
+{
+  struct chan_waiter* w;
+
+  if (ch->count > 0) {
+    if (val != NULL)
+      memcpy(val, slot(ch, ch->head), ch->size);
+    ch->head = (ch->head + 1) % ch->cap;
+    ch->count--;
+    /* A sender waiting for room takes it */
+    w = claim(&ch->senders);
+    if (w != NULL) {
+      memcpy(slot(ch, ch->head + ch->count), w->sel->cases[w->idx].val, ch->size);
+      ch->count++;
+      *wake = complete(w, 0);
+    }
+    return 0;
+  }
+  w = claim(&ch->senders);
+  if (w != NULL) {
+    if (val != NULL)
+      memcpy(val, w->sel->cases[w->idx].val, ch->size);
+    *wake = complete(w, 0);
+    return 0;
+  }
+  if (ch->closed) {
+    if (val != NULL)
+      memset(val, 0, ch->size);
+    return -1;
+  }
+  return NOT_READY;
+}
+
+/* Do the first case that can go on. Returns its index, or -1 if none can.
+   Called with the channels locked */
+static int try_cases(struct chan_sel* s, TCB** wake, int* direct)
+{
+  int i, r;
+
+  *wake = NULL;
+  *direct = 0;
+  for (i = 0; i < s->n; i++) {
+    struct mychan_case* c = &s->cases[i];
+
+    if (c->op == MYCHAN_SEND)
+      r = try_send(c->ch, c->val, wake, direct);
+    else
+      r = try_recv(c->ch, c->val, wake);
+    if (r != NOT_READY) {
+      c->ok = r;
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Queue the waiters of a select once its thread is off the CPU, unless a
+   case can be done now: then do it and let the thread go on. Once the
+   waiters are queued, another worker can wake the thread and s can be
+   gone: only locals are used after the unlock */
+static int park_select(TCB* t)
+{
+  struct chan_sel* s = t->wait;
+  TCB* wake;
+  int direct, i, which;
+
+  s->t = t;
+  lock_all(s);
+  which = s->which = try_cases(s, &wake, &direct);
+  if (which < 0) {
+    for (i = 0; i < s->n; i++) {
+      struct mychan* ch = s->cases[i].ch;
+
+      s->w[i].sel = s;
+      s->w[i].idx = i;
+      iqueue_push(s->cases[i].op == MYCHAN_SEND ? &ch->senders : &ch->receivers, &s->w[i].link);
+    }
+    s->queued = 1;
+  }
+  unlock_all(s);
+  /* In the middle of a switch: the partner does not preempt anyone */
+  if (wake != NULL)
+    sched_wake(wake);
+  return which >= 0;
+}
+
+/* Wake the partner of a completed case. A receiver of an unbuffered
+   channel gets the CPU at once */
+static void wake(TCB* t, int direct)
+{
+  int preempt;
+
+  if (t == NULL)
+    return;
+  if (direct) {
+    sched_handoff(t);
+    return;
+  }
+  preempt_disable();
+  preempt = sched_wake(t);
+  preempt_enable();
+  if (preempt)
+    sched_preempt();
+}
+
+int mychan_select(struct mychan_case* cases, int n)
+{
+  struct chan_sel s;
+  TCB* partner;
+  int direct, i, j, r;
+
+  if (n < 1 || n > MYCHAN_MAX_CASES)
+    return -1;
+  s.cases = cases;
+  s.n = n;
+  s.nlocks = 0;
+  /* Distinct channels sorted by address */
+  for (i = 0; i < n; i++) {
+    struct mychan* ch = cases[i].ch;
+
+    for (j = 0; j < s.nlocks && s.order[j] < ch; j++);
+    if (j < s.nlocks && s.order[j] == ch)
+      continue;
+    memmove(&s.order[j + 1], &s.order[j], (s.nlocks - j) * sizeof(s.order[0]));
+    s.order[j] = ch;
+    s.nlocks++;
+  }
+
+  for (;;) {
+    preempt_disable();
+    lock_all(&s);
+    r = try_cases(&s, &partner, &direct);
+    unlock_all(&s);
+    preempt_enable();
+    if (r >= 0) {
+      wake(partner, direct);
+      return r;
+    }
+    s.queued = 0;
+    s.which = -1;
+    atomic_store(&s.fired, 0);
+    sched_block(park_select, &s);
+    if (s.which >= 0)
+      break;
+  }
+  /* A partner popped the waiter of the case it did; drop the others */
+  if (s.queued) {
+    preempt_disable();
+    lock_all(&s);
+    for (i = 0; i < n; i++) {
+      struct mychan* ch = cases[i].ch;
+
+      if (i != s.which)
+        iqueue_remove(cases[i].op == MYCHAN_SEND ? &ch->senders : &ch->receivers, &s.w[i].link);
+    }
+    unlock_all(&s);
+    preempt_enable();
+  }
+  return s.which;
+}
+
+int mychan_send(struct mychan* ch, const void* val)
+{
+  struct mychan_case c = { ch, MYCHAN_SEND, (void*) val, 0 };
+
+  mychan_select(&c, 1);
+  return c.ok;
+}
+
+int mychan_recv(struct mychan* ch, void* val)
+{
+  struct mychan_case c = { ch, MYCHAN_RECV, val, 0 };
+
+  mychan_select(&c, 1);
+  return c.ok;
+}
+
+void mychan_close(struct mychan* ch)
+{
+  struct iqueue woken;
+  struct chan_waiter* w;
+  int preempt = 0;
+  TCB* t;
+
+  iqueue_init(&woken);
+  preempt_disable();
+  spin_lock(&ch->lock);
+  ch->closed = 1;
+  /* Receivers only wait on an empty channel: all of them get nothing */
+  while ((w = claim(&ch->receivers)) != NULL) {
+    void* dst = w->sel->cases[w->idx].val;
+
+    if (dst != NULL)
+      memset(dst, 0, ch->size);
+    tcb_enqueue(&woken, complete(w, -1));
+  }
+  while ((w = claim(&ch->senders)) != NULL)
+    tcb_enqueue(&woken, complete(w, -1));
+  spin_unlock(&ch->lock);
+  while ((t = tcb_dequeue(&woken)) != NULL)
+    preempt |= sched_wake(t);
+  preempt_enable();
+  if (preempt)
+    sched_preempt();
+}
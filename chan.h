@@ -0,0 +1,45 @@
+#ifndef _CHAN_H_
+#define _CHAN_H_
+
+#include <stddef.h>
+
+#include "queue.h"
+#include "spinlock.h"
+
+/* Channels between green threads, like the ones of Go. A channel carries
+   values of a fixed size and has a buffer of cap values; with cap 0 it is
+   unbuffered and every send meets a receive. Senders and receivers that
+   cannot go on are BLOCKED on the queues of the channel, and the thread
+   that comes next copies the value straight from or to the one waiting.
+   A send on an unbuffered channel that finds a receiver waiting switches
+   directly to it, without the round trip through the run queue. The
+   functions are in mythread.h. */
+
+/* Maximum number of cases of mychan_select() */
+#define MYCHAN_MAX_CASES 16
+
+struct mychan
+{
+  spinlock_t lock;
+  size_t size;             /* Of a value */
+  int cap;                 /* Values in the buffer */
+  int count;               /* Values buffered now */
+  int head;                /* Index of the oldest one */
+  int closed;
+  struct iqueue senders;   /* Waiting to send: struct chan_waiter */
+  struct iqueue receivers; /* Waiting to receive */
+  char* buf;
+};
+
+/* A case of mychan_select() */
+enum { MYCHAN_SEND, MYCHAN_RECV };
+
+struct mychan_case
+{
+  struct mychan* ch;
+  int op;                  /* MYCHAN_SEND or MYCHAN_RECV */
+  void* val;               /* Value to send, or where to receive one */
+  int ok;                  /* Set by mychan_select(): 0, or -1 if the channel is closed */
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+#include "context.h"
+
+#ifdef CTX_ASM
+
+/* Initial value of MXCSR and of the x87 control word */
+#define MXCSR_DEFAULT 0x1f80
+#define FPUCW_DEFAULT 0x037f
+
+/* Frame saved by ctx_switch(), from the saved stack pointer upwards */
+struct ctx_frame
+{
+  uint32_t mxcsr;
+  uint32_t fpucw;
+  uint64_t r15, r14, r13, r12, rbx, rbp;
+  uint64_t ret;
+};
+
+__asm__ (
+  ".text\n"
+  ".globl ctx_switch\n"
+  ".type ctx_switch, @function\n"
+  "ctx_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rdi\n"
+  ".globl ctx_jump\n"
+  ".type ctx_jump, @function\n"
+  "ctx_jump:\n"
+  "  movq (%rdi), %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size ctx_switch, .-ctx_switch\n"
+);
+
+void ctx_make(struct context* c, void* stack, size_t size, void (*entry)(void))
+{
+  /* entry() is reached by the ret of ctx_jump() and must see the stack as
+     after a call: 16-byte aligned plus the (null) return address */
+  uintptr_t top = ((uintptr_t) stack + size) & ~(uintptr_t) 15;
+  struct ctx_frame* f = (struct ctx_frame*) (top - 8) - 1;
+
+  f->mxcsr = MXCSR_DEFAULT;
+  f->fpucw = FPUCW_DEFAULT;
+  f->r15 = f->r14 = f->r13 = f->r12 = f->rbx = f->rbp = 0;
+  f->ret = (uintptr_t) entry;
+  *(uint64_t*) (top - 8) = 0;
+  c->sp = f;
+}
+
+#else
+
+void ctx_make(struct context* c, void* stack, size_t size, void (*entry)(void))
+{
+  if(getcontext(&c->uc) == -1){
+    perror("*** ERROR: getcontext in ctx_make");
+    exit(-1);
+  }
+  c->uc.uc_stack.ss_sp = stack;
+  c->uc.uc_stack.ss_size = size;
+  c->uc.uc_stack.ss_flags = 0;
+  c->uc.uc_link = NULL;
+  makecontext(&c->uc, entry, 0);
+}
+
+void ctx_switch(struct context* from, struct context* to)
+{
+  swapcontext(&from->uc, &to->uc);
+}
+
+void ctx_jump(struct context* to)
+{
+  setcontext(&to->uc);
+}
+
+#endif
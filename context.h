@@ -0,0 +1,33 @@
+#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+#include <stddef.h>
+#include <ucontext.h>
+
+/* Thread contexts. On x86-64 the switch is a few instructions of assembly
+   that save the callee-saved registers, the stack pointer and the SSE/x87
+   control words on the stack of the thread that leaves the CPU. Everything
+   else is dead across a function call. Elsewhere, or when MYTHREAD_UCONTEXT
+   is defined, the portable ucontext functions are used. They also save and
+   restore the signal mask with a system call on every switch. */
+#if defined(__x86_64__) && !defined(MYTHREAD_UCONTEXT)
+#define CTX_ASM 1
+#endif
+
+struct context
+{
+#ifdef CTX_ASM
+  void* sp; /* Stack pointer; the registers are saved on the stack */
+#else
+  ucontext_t uc;
+#endif
+};
+
+/* Prepare c to start running entry() on the given stack */
+void ctx_make(struct context* c, void* stack, size_t size, void (*entry)(void));
+/* Save the current context in from and resume to */
+void ctx_switch(struct context* from, struct context* to);
+/* Resume to, discarding the current context */
+void ctx_jump(struct context* to);
+
+#endif
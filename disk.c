@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "disk.h"
+#include "interrupt.h"
+#include "spinlock.h"
+
+#define RING_ENTRIES 256   /* Submission queue of io_uring */
+#define POOL_THREADS 4     /* Default threads of the pool backend (MYTHREAD_DISK_THREADS) */
+
+static pthread_once_t disk_once = PTHREAD_ONCE_INIT;
+static int disk_ok = -1;
+static int (*submit)(struct disk_req* r) = NULL;
+static const char* backend = "none";
+/* Completed requests not yet seen by the scheduler */
+static struct mpsc completed = { NULL };
+
+/* Tell the scheduler that r is done */
+static void complete(struct disk_req* r, ssize_t result)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  r->result = result;
+  r->done_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  atomic_store(&r->done, 1);
+  disk_post(r);
+}
+
+/* Helper threads block every signal: the timer, disk and I/O signals must
+   reach the workers that run the green threads */
+static int start_helper(void* (*fn)(void*))
+{
+  sigset_t all, old;
+  pthread_t th;
+  int rc;
+
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  rc = pthread_create(&th, NULL, fn, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (rc != 0)
+    return -1;
+  pthread_detach(th);
+  return 0;
+}
+
+/* io_uring through the raw system calls. The submission ring is shared
+   by the workers; one reaper thread waits for the completions */
+static struct
+{
+  int fd;
+  unsigned entries;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+} ring;
+static spinlock_t sq_lock = SPINLOCK_INIT;
+
+static int uring_enter(unsigned submit, unsigned wait, unsigned flags)
+{
+  return syscall(__NR_io_uring_enter, ring.fd, submit, wait, flags, NULL, 0);
+}
+
+static int uring_submit(struct disk_req* r)
+{
+  struct io_uring_sqe* sqe;
+  unsigned tail, idx;
+  int rc;
+
+  spin_lock(&sq_lock);
+  tail = *ring.sq_tail;
+  if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) >= ring.entries){
+    spin_unlock(&sq_lock);
+    return -1;
+  }
+  idx = tail & *ring.sq_mask;
+  sqe = &ring.sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = r->fd;
+  sqe->off = r->offset;
+  sqe->addr = (unsigned long) r->buf;
+  sqe->len = r->len;
+  sqe->user_data = (unsigned long) r;
+  ring.sq_array[idx] = idx;
+  __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+  spin_unlock(&sq_lock);
+  /* Outside the lock: each call submits one of the published entries,
+     not necessarily this one, and the entry cannot be taken back, so an
+     interrupted call is retried */
+  do {
+    rc = uring_enter(1, 0, 0);
+  } while (rc == -1 && errno == EINTR);
+  if (rc == -1){
+    perror("io_uring_enter");
+    exit(3);
+  }
+  return 0;
+}
+
+static void* uring_reaper(void* arg)
+{
+  while (1) {
+    unsigned head;
+    int n = 0;
+
+    if (uring_enter(0, 1, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR) {
+      perror("io_uring_enter");
+      exit(3);
+    }
+    head = *ring.cq_head;
+    while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+      complete((struct disk_req*) (unsigned long) cqe->user_data, cqe->res);
+      head++;
+      n++;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    if (n > 0)
+      kill(getpid(), SIGIO);
+  }
+  return NULL;
+}
+
+static int uring_init(void)
+{
+  struct io_uring_params p;
+  size_t sq_size, cq_size;
+  char *sq, *cq;
+
+  memset(&p, 0, sizeof(p));
+  ring.fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+  if (ring.fd == -1)
+    return -1;
+  sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cq_size > sq_size) sq_size = cq_size;
+    cq_size = sq_size;
+  }
+  sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED)
+    goto fail;
+  cq = sq;
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+    cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED)
+      goto fail;
+  }
+  ring.sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+  if (ring.sqes == MAP_FAILED)
+    goto fail;
+  ring.entries = p.sq_entries;
+  ring.sq_head = (unsigned*) (sq + p.sq_off.head);
+  ring.sq_tail = (unsigned*) (sq + p.sq_off.tail);
+  ring.sq_mask = (unsigned*) (sq + p.sq_off.ring_mask);
+  ring.sq_array = (unsigned*) (sq + p.sq_off.array);
+  ring.cq_head = (unsigned*) (cq + p.cq_off.head);
+  ring.cq_tail = (unsigned*) (cq + p.cq_off.tail);
+  ring.cq_mask = (unsigned*) (cq + p.cq_off.ring_mask);
+  ring.cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+  if (start_helper(uring_reaper) == -1)
+    goto fail;
+  return 0;
+fail:
+  close(ring.fd);
+  return -1;
+}
+
+/* Pool backend: blocking pread() on helper threads */
+static struct iqueue pool_queue;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+
+static int pool_submit(struct disk_req* r)
+{
+  pthread_mutex_lock(&pool_mutex);
+  iqueue_push(&pool_queue, &r->link);
+  pthread_cond_signal(&pool_cond);
+  pthread_mutex_unlock(&pool_mutex);
+  return 0;
+}
+
+static void* pool_thread(void* arg)
+{
+  while (1) {
+    struct disk_req* r;
+    ssize_t n;
+
+    pthread_mutex_lock(&pool_mutex);
+    while (iqueue_empty(&pool_queue))
+      pthread_cond_wait(&pool_cond, &pool_mutex);
+    r = queue_entry(iqueue_pop(&pool_queue), struct disk_req, link);
+    pthread_mutex_unlock(&pool_mutex);
+
+    n = pread(r->fd, r->buf, r->len, r->offset);
+    complete(r, n == -1 ? -errno : n);
+    kill(getpid(), SIGIO);
+  }
+  return NULL;
+}
+
+static int pool_init(void)
+{
+  const char* env = getenv("MYTHREAD_DISK_THREADS");
+  int n = env ? atoi(env) : POOL_THREADS;
+  int i;
+
+  if (n < 1)
+    n = 1;
+  iqueue_init(&pool_queue);
+  for (i = 0; i < n; i++)
+    if (start_helper(pool_thread) == -1)
+      return i > 0 ? 0 : -1;
+  return 0;
+}
+
+static void disk_start(void)
+{
+  const char* env = getenv("MYTHREAD_DISK");
+
+  if ((env == NULL || strcmp(env, "pool") != 0) && uring_init() == 0) {
+    submit = uring_submit;
+    backend = "io_uring";
+    disk_ok = 0;
+  } else if (pool_init() == 0) {
+    submit = pool_submit;
+    backend = "pool";
+    disk_ok = 0;
+  }
+}
+
+int disk_init(void)
+{
+  /* A thread preempted inside disk_start() would leave the others of its
+     worker waiting in pthread_once() forever */
+  preempt_disable();
+  pthread_once(&disk_once, disk_start);
+  preempt_enable();
+  return disk_ok;
+}
+
+int disk_submit(struct disk_req* r)
+{
+  int rc;
+
+  atomic_init(&r->done, 0);
+  atomic_init(&r->handoff, 0);
+  /* The submission lock of either backend must not be held by a thread
+     that another one on the same worker preempts */
+  preempt_disable();
+  rc = submit(r);
+  preempt_enable();
+  return rc;
+}
+
+void disk_post(struct disk_req* r)
+{
+  mpsc_push(&completed, &r->link);
+}
+
+int disk_reap(struct iqueue* out)
+{
+  if (mpsc_empty(&completed))
+    return 0;
+  return mpsc_take(&completed, out);
+}
+
+const char* disk_backend(void)
+{
+  return backend;
+}
@@ -0,0 +1,55 @@
+#ifndef _DISK_H_
+#define _DISK_H_
+
+#include <sys/types.h>
+#include <stdatomic.h>
+
+#include "queue.h"
+
+/* Asynchronous disk backend of read_disk(): reads are issued through
+   io_uring, or a pool of pthreads where io_uring is missing. Completed
+   requests are posted to a lock-free completion queue and the process
+   gets a SIGIO, which runs disk_interrupt(); the scheduler takes them
+   from the queue with disk_reap(). The backend never touches the
+   scheduler state. */
+
+/* One read. It lives on the stack of the thread that waits for it */
+struct disk_req
+{
+  int fd;
+  off_t offset;
+  void* buf;
+  size_t len;
+  ssize_t result;          /* Bytes read, or -errno */
+  atomic_int done;         /* Set by the backend before it posts SIGIO */
+  long long done_ns;       /* CLOCK_MONOTONIC time of the completion */
+  atomic_int handoff;      /* Parties done with it: the parked waiter and the reaper */
+  void* waiter;            /* Thread that waits for it */
+  struct queue_link link;  /* Link in the pool request queue, then in the completion queue */
+};
+
+/* Wake-ups of the threads waiting for reads (mythread_diskstats()) */
+struct disk_stats
+{
+  long woken;              /* Threads woken */
+  long batches;            /* Disk interrupts that woke at least one */
+  long max_batch;          /* Most threads woken by one interrupt */
+  long long delay_ns;      /* Total time from completion to wake-up */
+  long long max_delay_ns;
+};
+
+/* Start the backend the first time it is called: io_uring, or the pool
+   if io_uring is not available or MYTHREAD_DISK=pool. Returns -1 on error */
+int disk_init(void);
+/* Issue the read r. Returns -1 if it could not be issued */
+int disk_submit(struct disk_req* r);
+/* Post r to the completion queue. Lock-free: it can be called from any
+   thread or signal handler */
+void disk_post(struct disk_req* r);
+/* Move every request posted since the last call to out, in completion
+   order. Returns how many there were */
+int disk_reap(struct iqueue* out);
+/* Name of the backend in use: "io_uring" or "pool" */
+const char* disk_backend(void);
+
+#endif
@@ -4,10 +4,61 @@
 #include <stdlib.h>
 #include <ucontext.h>
 #include <unistd.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <stdatomic.h>
 #include <interrupt.h>
 #include <time.h>
 
-static sigset_t maskval_interrupt,oldmask_interrupt;
+/* Critical sections do not block the signals: they raise a per kernel
+   thread counter, and a handler that comes while it is not zero only
+   marks itself pending. The pending handlers run when the outermost
+   critical section ends. The handlers are installed with SA_NODEFER, so
+   no signal is ever blocked and a context switch inside a handler needs
+   no system call either. */
+#define PENDING_TIMER 1
+#define PENDING_DISK 2
+#define PENDING_IO 4
+
+static __thread int preempt_count = 0;
+static __thread atomic_int pending = 0;
+/* Handler of SIGVTALRM in use: periodic, per worker or tickless */
+static void (*timer_handler)() = NULL;
+
+void my_disk_handler ();
+void my_io_handler ();
+
+/* Returns 1 if the handler must wait for the end of the critical section */
+static int defer(int bit)
+{
+  if (preempt_count > 0){
+    atomic_fetch_or_explicit(&pending, bit, memory_order_relaxed);
+    return 1;
+  }
+  return 0;
+}
+
+void preempt_disable(){
+  preempt_count++;
+  atomic_signal_fence(memory_order_seq_cst);
+}
+
+void preempt_enable(){
+  int p;
+
+  atomic_signal_fence(memory_order_seq_cst);
+  if (--preempt_count > 0)
+    return;
+  /* A handler run here can switch to another thread */
+  while ((p = atomic_exchange_explicit(&pending, 0, memory_order_relaxed)) != 0){
+    if (p & PENDING_DISK)
+      my_disk_handler();
+    if (p & PENDING_IO)
+      my_io_handler();
+    if (p & PENDING_TIMER)
+      timer_handler();
+  }
+}
 
 
 void reset_timer(long usec) {
@@ -27,16 +78,16 @@ void reset_timer(long usec) {
 }
 
 void enable_interrupt(){
-  sigprocmask(SIG_SETMASK, &oldmask_interrupt, NULL);
+  preempt_enable();
 }
 
 void disable_interrupt(){
-  sigaddset(&maskval_interrupt, SIGVTALRM);
-  sigprocmask(SIG_BLOCK, &maskval_interrupt, &oldmask_interrupt);
+  preempt_disable();
 }
 
 void my_handler ()
 {
+   if (defer(PENDING_TIMER)) return;
    reset_timer(TICK_TIME) ;
    timer_interrupt() ;
 }
@@ -46,12 +97,11 @@ void init_interrupt()
 {
   void timer_interrupt(int sig);
   struct sigaction sigdat;
-  /* Initializes the signal mask to empty */
-  sigemptyset(&maskval_interrupt); 
   /* Prepare a virtual time alarm */
+  timer_handler = my_handler;
   sigdat.sa_handler = my_handler;
   sigemptyset(&sigdat.sa_mask);
-  sigdat.sa_flags = SA_RESTART;
+  sigdat.sa_flags = SA_RESTART | SA_NODEFER;
   if(sigaction(SIGVTALRM, &sigdat, (struct sigaction *)0) == -1){
     perror("signal set error");
     exit(2);
@@ -59,7 +109,60 @@ void init_interrupt()
    reset_timer(TICK_TIME) ;
 }
 
-static sigset_t maskval_net_interrupt,oldmask_net_interrupt;
+void my_thread_handler ()
+{
+   if (defer(PENDING_TIMER)) return;
+   timer_interrupt() ;
+}
+
+/* Clock interrupt of one worker in M:N mode: a periodic timer on the CPU
+   time of the calling kernel thread that sends SIGVTALRM to that thread only */
+void init_thread_interrupt()
+{
+  struct sigaction sigdat;
+  struct sigevent event;
+  struct itimerspec timerdata;
+  timer_t timer_id;
+
+  timer_handler = my_thread_handler;
+  sigdat.sa_handler = my_thread_handler;
+  sigemptyset(&sigdat.sa_mask);
+  sigdat.sa_flags = SA_RESTART | SA_NODEFER;
+  if(sigaction(SIGVTALRM, &sigdat, (struct sigaction *)0) == -1){
+    perror("signal set error");
+    exit(2);
+  }
+
+  memset(&event, 0, sizeof(event));
+  event.sigev_notify = SIGEV_THREAD_ID;
+  event.sigev_signo = SIGVTALRM;
+  event._sigev_un._tid = syscall(SYS_gettid);
+  if(timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer_id) == -1){
+    perror("timer_create");
+    exit(3);
+  }
+  timerdata.it_interval.tv_sec = TICK_TIME / 1000000;
+  timerdata.it_interval.tv_nsec = (TICK_TIME % 1000000) * 1000;
+  timerdata.it_value = timerdata.it_interval;
+  if(timer_settime(timer_id, 0, &timerdata, NULL) == -1){
+    perror("timer_settime");
+    exit(3);
+  }
+}
+
+
+/* Seed of data_in_page_cache() */
+static void seed_disk()
+{
+#ifdef DISK_INTERRUPT_SEED
+ srand(DISK_INTERRUPT_SEED);
+#else
+ struct timespec ts;
+ 
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ srand(ts.tv_nsec);
+#endif
+}
 
 void reset_disk_timer(long usec) {
   struct itimerval quantum;
@@ -78,18 +181,18 @@ void reset_disk_timer(long usec) {
 }
 
 void enable_disk_interrupt(){
-  sigprocmask(SIG_SETMASK, &oldmask_net_interrupt, NULL);
+  preempt_enable();
 }
 
 void disable_disk_interrupt(){
-  sigaddset(&maskval_net_interrupt, SIGPROF);
-  sigprocmask(SIG_BLOCK, &maskval_net_interrupt, &oldmask_net_interrupt);
+  preempt_disable();
 }
 
 void my_disk_handler ()
 {
+  if (defer(PENDING_DISK)) return;
   // reset_disk_timer(PACK_TIME) ;
-   disk_interrupt() ;
+   disk_interrupt(SIGPROF) ;
 }
 
 
@@ -107,16 +210,14 @@ void init_disk_interrupt()
  timer_create (CLOCK_REALTIME, &event, &timer_id);
   
  // set periodTime time
- periodTime.tv_sec=1;
- periodTime.tv_nsec=0;
+ periodTime.tv_sec=DISK_TIME / 1000000;
+ periodTime.tv_nsec=(DISK_TIME % 1000000) * 1000;
 
- /* Initializes the signal mask to empty */
- sigemptyset(&maskval_net_interrupt); 
  /* Prepare a virtual time alarm */
 
  sigdat.sa_handler = my_disk_handler;
  sigemptyset(&sigdat.sa_mask);
- sigdat.sa_flags = SA_RESTART;
+ sigdat.sa_flags = SA_RESTART | SA_NODEFER;
 
  /* Arm periodic timer */
  timerdata.it_interval = periodTime;
@@ -129,12 +230,129 @@ void init_disk_interrupt()
  }
  //reset_disk_timer(PACK_TIME) ;
 
-#ifdef DISK_INTERRUPT_SEED
- srand(DISK_INTERRUPT_SEED);
-#else
- struct timespec ts;
- 
- clock_gettime(CLOCK_MONOTONIC, &ts);
- srand(ts.tv_nsec);
-#endif
+ seed_disk();
+}
+
+/* Tickless mode: one one-shot CLOCK_MONOTONIC timer replaces both the
+   periodic clock tick and the disk timer. It is armed for whichever comes
+   first, the end of the quantum of the running thread or the next disk
+   interrupt, and its SIGVTALRM handler calls disk_interrupt() and/or
+   timer_interrupt() for the events that are due. */
+static timer_t tickless_timer;
+static long long quantum_deadline = 0;   /* 0: no quantum armed */
+static long long disk_deadline;
+
+static long long now_usec()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* Program the timer for the earliest pending event */
+static void tickless_program(long long now)
+{
+  struct itimerspec timerdata;
+  long long next = disk_deadline;
+
+  if (quantum_deadline != 0 && quantum_deadline < next)
+    next = quantum_deadline;
+  next -= now;
+  if (next < 1)
+    next = 1;
+  timerdata.it_interval.tv_sec = 0;
+  timerdata.it_interval.tv_nsec = 0;
+  timerdata.it_value.tv_sec = next / 1000000;
+  timerdata.it_value.tv_nsec = (next % 1000000) * 1000;
+  if(timer_settime(tickless_timer, 0, &timerdata, NULL) == -1){
+    perror("timer_settime");
+    exit(3);
+  }
+}
+
+/* Arm the quantum of the running thread to expire in usec microseconds,
+   or disarm it if usec is 0. Called with the clock interrupt disabled */
+void tickless_arm(long usec)
+{
+  long long now = now_usec();
+
+  quantum_deadline = usec ? now + usec : 0;
+  tickless_program(now);
+}
+
+void my_tickless_handler ()
+{
+  long long now;
+  int disk = 0, quantum = 0;
+
+  if (defer(PENDING_TIMER)) return;
+  now = now_usec();
+
+  if (now >= disk_deadline){
+    disk = 1;
+    disk_deadline += DISK_TIME;
+    if (disk_deadline <= now)
+      disk_deadline = now + DISK_TIME;
+  }
+  if (quantum_deadline != 0 && now >= quantum_deadline){
+    quantum = 1;
+    quantum_deadline = 0;
+  }
+  /* Re-arm before the handlers: they can switch to another thread and
+     not come back for a long time */
+  tickless_program(now);
+  if (disk)
+    disk_interrupt(SIGPROF);
+  /* If disk_interrupt() switched threads the quantum was armed again
+     when this thread got the CPU back */
+  if (quantum && quantum_deadline == 0)
+    timer_interrupt();
+}
+
+void init_tickless_interrupt()
+{
+  struct sigaction sigdat;
+  struct sigevent event;
+
+  timer_handler = my_tickless_handler;
+  sigdat.sa_handler = my_tickless_handler;
+  sigemptyset(&sigdat.sa_mask);
+  sigdat.sa_flags = SA_RESTART | SA_NODEFER;
+  if(sigaction(SIGVTALRM, &sigdat, (struct sigaction *)0) == -1){
+    perror("signal set error");
+    exit(2);
+  }
+
+  memset(&event, 0, sizeof(event));
+  event.sigev_notify = SIGEV_SIGNAL;
+  event.sigev_signo = SIGVTALRM;
+  if(timer_create(CLOCK_MONOTONIC, &event, &tickless_timer) == -1){
+    perror("timer_create");
+    exit(3);
+  }
+  disk_deadline = now_usec() + DISK_TIME;
+  tickless_arm(0);
+  seed_disk();
+}
+
+/* Completion of a real read (see disk.c): the backend sends SIGIO to the
+   process and disk_interrupt() wakes the threads whose reads are done */
+void my_io_handler ()
+{
+  if (defer(PENDING_IO)) return;
+  disk_interrupt(SIGIO);
+}
+
+void init_io_interrupt()
+{
+  struct sigaction sigdat;
+
+  sigdat.sa_handler = my_io_handler;
+  sigemptyset(&sigdat.sa_mask);
+  sigdat.sa_flags = SA_RESTART | SA_NODEFER;
+  if(sigaction(SIGIO, &sigdat, (struct sigaction *)0) == -1){
+    perror("signal set error");
+    exit(2);
+  }
 }
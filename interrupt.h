@@ -1,3 +1,6 @@
+#ifndef _INTERRUPT_H_
+#define _INTERRUPT_H_
+
 #include <stdio.h>
 #include <sys/time.h>
 #include <signal.h>
@@ -11,14 +14,24 @@
 
 
 #define TICK_TIME 5000
+/* Period of the disk interrupt in microseconds */
+#define DISK_TIME 1000000
 #define PACK_TIME 1
 #define STARVATION 200
 
 // Define this macro for predictable and consistent behavior between executions
 //#define DISK_INTERRUPT_SEED 0xff00ff00
 
+/* Critical sections without system calls: the timer and disk handlers
+   that come between preempt_disable() and preempt_enable() are deferred
+   to the outermost preempt_enable(). disable_interrupt() and
+   disable_disk_interrupt() are the same critical section */
+void preempt_disable();
+void preempt_enable();
+
 void timer_interrupt ();
 void init_interrupt();
+void init_thread_interrupt();
 void disable_interrupt();
 void enable_interrupt();
 
@@ -26,3 +39,10 @@ void disk_interrupt ();
 void init_disk_interrupt();
 void disable_disk_interrupt();
 void enable_disk_interrupt();
+void init_io_interrupt();
+
+/* Tickless mode: a single one-shot timer for the quantum and the disk */
+void init_tickless_interrupt();
+void tickless_arm(long usec);
+
+#endif
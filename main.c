@@ -11,7 +11,7 @@
 void fun1 (int global_index)
 {
   int a=0, b=0;
-read_disk();
+read_disk(DISK_SIM, 1 * CACHE_BLOCK, NULL, CACHE_BLOCK);
   for (a=0; a<10; ++a) { 
 //    printf ("Thread %d with priority %d\t from fun2 a = %d\tb = %d\n", mythread_gettid(), mythread_getpriority(), a, b);
     for (b=0; b<25000000; ++b);
@@ -29,7 +29,7 @@ read_disk();
 void fun2 (int global_index)
 {
   int a=0, b=0;
-  read_disk();
+  read_disk(DISK_SIM, 2 * CACHE_BLOCK, NULL, CACHE_BLOCK);
   for (a=0; a<10; ++a) {
   //  printf ("Thread %d with priority %d\t from fun2 a = %d\tb = %d\n", mythread_gettid(), mythread_getpriority(), a, b);
     for (b=0; b<18000000; ++b);
@@ -64,12 +64,12 @@ int main(int argc, char *argv[])
   int i,j,k,l,m,a,b=0;
 
   mythread_setpriority(HIGH_PRIORITY);
-  read_disk();
+  read_disk(DISK_SIM, 0, NULL, CACHE_BLOCK);
   if((i = mythread_create(fun1,LOW_PRIORITY)) == -1){
     printf("thread failed to initialize\n");
     exit(-1);
   }
- read_disk();
+ read_disk(DISK_SIM, 0, NULL, CACHE_BLOCK);
   if((j = mythread_create(fun2,LOW_PRIORITY)) == -1){
     printf("thread failed to initialize\n");
     exit(-1);
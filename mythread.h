@@ -1,3 +1,6 @@
+#ifndef _MYTHREAD_H_
+#define _MYTHREAD_H_
+
 #include <stdio.h>
 #include <sys/time.h>
 #include <signal.h>
@@ -6,34 +9,161 @@
 #include <unistd.h>
 
 #include "interrupt.h"
+#include "context.h"
+#include "queue.h"
+#include "runqueue.h"
+#include "cache.h"
+#include "disk.h"
+#include "wheel.h"
+#include "sync.h"
+#include "chan.h"
+#include "pheap.h"
 
-#define N 10
 #define FREE 0
 #define INIT 1
 #define WAITING 2
 #define IDLE 3
+#define BLOCKED 4
+
+/* File descriptor of a simulated read_disk(), with no I/O */
+#define DISK_SIM -1
 
 #define STACKSIZE 10000
 #define QUANTUM_TICKS 40
 
+/* Priority levels go from 0 to MAX_PRIORITY-1 (see runqueue.h). Levels from
+   HIGH_PRIORITY up run FIFO without quantum, the ones below in round robin */
 #define LOW_PRIORITY 0
-#define HIGH_PRIORITY 1
-#define SYSTEM 2
+#define HIGH_PRIORITY 100
+#define SYSTEM MAX_PRIORITY
+
+/* Weight of a thread in the cfs policy: with twice the weight it gets
+   twice the CPU */
+#define DEFAULT_WEIGHT 1024
+#define MAX_WEIGHT (1024 * 1024)
+
+/* mythread_getstats() of every thread, finished ones included */
+#define MYTHREAD_ALL -2
+
+/* Scheduling accounting of a thread, in nanoseconds of CLOCK_MONOTONIC */
+struct mythread_stats
+{
+  long long run_ns;        /* On the CPU */
+  long long ready_ns;      /* Ready, waiting in a run queue */
+  long long max_ready_ns;  /* Longest single wait in a run queue */
+  long long blocked_ns;    /* Waiting for read_disk(), a join, a sleep or a lock */
+  long dispatches;         /* Times it got the CPU */
+  long voluntary;          /* Switches because it blocked */
+  long involuntary;        /* Switches because it was preempted */
+  long jobs;               /* Jobs ended with mythread_wait_period() by a thread of the EDF class, not by mythread_exit() */
+  long misses;             /* Jobs finished after their deadline */
+  long long max_lateness_ns; /* Longest time past a deadline */
+};
+
+/* Reservation of a thread of the EDF class, in nanoseconds (see EDF.c) */
+struct edf_params
+{
+  long long period;        /* 0 if the thread is not in the EDF class */
+  long long budget;        /* CPU time of a job in each period */
+  long long rel_deadline;  /* Deadline of a job from its release */
+  long long release;       /* Release of the next job or budget */
+  long long job_deadline;  /* Deadline of the current job */
+  long long deadline;      /* Deadline of the current budget, the one EDF uses */
+  long long budget_start;  /* stats.run_ns when the budget was granted */
+  int phase;               /* Running a job, or waiting for the next job or budget */
+};
+
 /* Structure containing thread state  */
 typedef struct tcb{
-  int state; /* the state of the current block: FREE or INIT */
+  int state; /* the state of the current block: FREE, INIT, WAITING (disk) or BLOCKED */
   int tid; /* thread id*/
   int priority; /* thread priority*/
   int ticks;
   void (*function)(int);  /* the code of the thread */
-  ucontext_t run_env; /* Context of the running environment*/
+  void* stack; /* Stack of the thread, NULL for the main thread */
+  struct context run_env; /* Context of the running environment*/
+  struct queue_link link; /* Link in the ready or waiting queue */
+  struct disk_req* req; /* Read the thread waits for */
+  int (*park)(struct tcb* t); /* Queues a BLOCKED thread once it is off the CPU, returns 1 if it can run already */
+  void* wait; /* What a BLOCKED thread waits for */
+  unsigned wait_gen; /* Generation of the thread it joins */
+  unsigned gen; /* Incremented every time the TCB is reused */
+  struct iqueue joiners; /* Threads in mythread_join() on this one */
+  struct wtimer timer; /* Wake-up of mythread_sleep() */
+  long ready_tick; /* Tick of the policy when it was queued, for aging */
+  int boost; /* Promoted by the aging of the rrf policy until its quantum ends */
+  int weight; /* Share of the CPU in the cfs policy */
+  long long vruntime; /* Run time scaled by the weight, in the cfs policy */
+  long long charged; /* Run time already added to vruntime */
+  struct pheap_node node; /* Node in the run queue of the cfs policy or the EDF class */
+  int level; /* Queue of the thread in the mlfq policy, 0 the highest */
+  int used; /* Ticks used of the quantum of that queue */
+  struct edf_params edf; /* Reservation in the EDF class */
+  long long stamp; /* When it last changed state, for the accounting */
+  struct mythread_stats stats; /* Accounting of the thread */
 }TCB;
 
+/* Queue a TCB through its embedded link: no allocation on context switch */
+static inline void tcb_enqueue(struct iqueue* q, TCB* t) { iqueue_push(q, &t->link); }
+/* Dequeue the first TCB. Returns NULL if the queue is empty */
+static inline TCB* tcb_dequeue(struct iqueue* q)
+{
+  struct queue_link* l = iqueue_pop(q);
+  return l ? queue_entry(l, TCB, link) : NULL;
+}
+/* Return the first TCB without dequeuing it, NULL if the queue is empty */
+static inline TCB* tcb_peek(struct iqueue* q) { return q->head ? queue_entry(q->head, TCB, link) : NULL; }
+/* Queue a TCB in the level of its priority */
+static inline void tcb_rq_push(struct runqueue* rq, TCB* t) { rq_push(rq, &t->link, t->priority); }
+/* Dequeue the TCB with the highest priority. Returns NULL if the run queue is empty */
+static inline TCB* tcb_rq_pop(struct runqueue* rq)
+{
+  struct queue_link* l = rq_pop(rq);
+  return l ? queue_entry(l, TCB, link) : NULL;
+}
+
 int mythread_create (void (*fun_addr)(), int priority); /* Creates a new thread with one argument */
-void mythread_setpriority(int priority); /* Sets the thread priority */
+int mythread_create_deadline(void (*fun_addr)(), long period, long budget, long deadline); /* Creates a thread of the EDF class that needs budget microseconds every period within deadline. Returns -1 if it is not admitted */
+int mythread_wait_period(); /* Ends the job of the calling EDF thread and waits for its next period */
+int mythread_setpriority(int priority); /* Sets the thread priority. Returns -1 if it is out of range */
 int mythread_getpriority(); /* Returns the priority of calling thread*/
+int mythread_setweight(int weight); /* Sets the weight of the calling thread (cfs policy). Returns -1 if it is out of range */
+int mythread_getweight(); /* Returns the weight of the calling thread */
 void mythread_exit(); /* Frees the thread structure and exits the thread */
+void mythread_yield(); /* Gives the CPU to another ready thread */
+int mythread_join(int tid); /* Waits for the thread tid to finish */
+void mythread_sleep(long usec); /* Blocks the calling thread for usec microseconds at least */
+void mythread_mutex_init(mythread_mutex_t* m); /* Initializes a free mutex */
+void mythread_mutex_lock(mythread_mutex_t* m); /* Takes the mutex, blocking while another thread has it */
+int mythread_mutex_trylock(mythread_mutex_t* m); /* Takes the mutex if it is free, returns -1 otherwise */
+void mythread_mutex_unlock(mythread_mutex_t* m); /* Releases the mutex, to the first thread waiting for it if any */
+void mythread_cond_init(mythread_cond_t* c); /* Initializes a condition variable */
+void mythread_cond_wait(mythread_cond_t* c, mythread_mutex_t* m); /* Releases m, waits for a signal and takes m again */
+void mythread_cond_signal(mythread_cond_t* c); /* Wakes the first thread waiting on c */
+void mythread_cond_broadcast(mythread_cond_t* c); /* Wakes every thread waiting on c */
+void mythread_sem_init(mythread_sem_t* s, int value); /* Initializes a semaphore with value units */
+void mythread_sem_wait(mythread_sem_t* s); /* Takes a unit, blocking until there is one */
+int mythread_sem_trywait(mythread_sem_t* s); /* Takes a unit if there is one, returns -1 otherwise */
+void mythread_sem_post(mythread_sem_t* s); /* Adds a unit, to the first thread waiting for one if any */
+struct mychan* mychan_new(size_t size, int cap); /* Creates a channel of values of size bytes with a buffer of cap values (0: unbuffered) */
+void mychan_free(struct mychan* ch); /* Frees a channel nobody uses any more */
+int mychan_send(struct mychan* ch, const void* val); /* Sends a value, blocking while there is no room. Returns -1 if the channel is closed */
+int mychan_recv(struct mychan* ch, void* val); /* Receives a value, blocking until there is one. Returns -1 if the channel is closed and empty */
+void mychan_close(struct mychan* ch); /* Closes the channel: waiting senders and receivers get -1 */
+int mychan_select(struct mychan_case* cases, int n); /* Does the first of n cases that can go on, blocking until one can. Returns its index */
 int mythread_gettid(); /* Returns the thread id */
-int read_disk(); /* */
+ssize_t read_disk(int fd, off_t offset, void* buf, size_t len); /* Reads like pread(), blocking only the calling thread. fd DISK_SIM simulates a read */
+int mythread_setpolicy(const char* name); /* Selects the scheduling policy: "rr", "rrf", "rrfd", "ws", "cfs" or "mlfq" */
+int mythread_setworkers(int n); /* Runs the threads on n kernel threads (M:N) */
+int mythread_settickless(int on); /* Clock interrupt only at the end of the quantum */
+int mythread_setsim(int on); /* Deterministic simulation with a virtual clock */
+void mythread_compute(long usec); /* Computes for usec microseconds, of virtual time in simulation mode */
+long long mythread_idletime(); /* Nanoseconds spent idle, added over all workers */
+long long mythread_maxwait(int priority); /* Longest run queue wait of a thread of that priority, in nanoseconds */
+int mythread_setcache(long bytes); /* Sets the memory budget of the block cache */
+void mythread_cachestats(struct cache_stats* s); /* Hits, misses and evictions of the block cache */
+void mythread_diskstats(struct disk_stats* s); /* Wake-ups of the threads waiting for the disk */
+int mythread_getstats(int tid, struct mythread_stats* s); /* Scheduling accounting of a thread, or of all with MYTHREAD_ALL */
+const char* mythread_getpolicy(); /* Returns the name of the scheduling policy */
 
-static inline int data_in_page_cache() { return rand() & 0x01; }
+#endif
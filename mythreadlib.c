@@ -1,175 +1,1595 @@
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <signal.h>
 #include <stdlib.h>
-#include <ucontext.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <sys/stat.h>
 
 #include "mythread.h"
 #include "interrupt.h"
+#include "sched.h"
+#include "stack.h"
+#include "spinlock.h"
+#include "disk.h"
+#include "cache.h"
+#include "trace.h"
+#include "sim.h"
 
 #include "queue.h"
 
 TCB* scheduler();
-void activator();
+void activator(TCB* next);
 void timer_interrupt(int sig);
 void disk_interrupt(int sig);
 
-/* Array of state thread control blocks: the process allows a maximum of N threads */
-static TCB t_state[N]; 
+/* Scheduling events: a record in the trace ring when built with
+   MYTHREAD_TRACE, a line on stdout otherwise */
+#ifdef MYTHREAD_TRACE
+#define sched_event(type, tid, arg, ...) trace_record(type, tid, arg)
+#else
+#define sched_event(type, tid, arg, ...) printf(__VA_ARGS__)
+#endif
 
-/* Current running thread */
-static TCB* running;
-static int current = 0;
+/* Thread control blocks are allocated in slabs of SLAB_SIZE that are never
+   released, so a TCB does not move while it is queued and a tid maps to its
+   TCB with two array lookups. Free TCBs are kept in a LIFO list linked
+   through their queue link, which makes create and exit O(1) and recycles
+   thread ids. */
+#define SLAB_SIZE 256
+
+static TCB** slabs = NULL;
+static int nslabs = 0;
+static int max_slabs = 0;
+static struct queue_link* free_tcbs = NULL;
+static spinlock_t tcb_lock = SPINLOCK_INIT;
+/* Accounting of the finished threads, under tcb_lock */
+static struct mythread_stats retired;
+
+/* Kernel threads that run the green threads. There is one worker unless
+   M:N mode is enabled with mythread_setworkers() or MYTHREAD_WORKERS. Each
+   worker has its own running thread and idle thread. */
+struct worker
+{
+  int id;
+  TCB* running;          /* Current running thread */
+  TCB* prev;             /* Thread that just left the CPU, see finish_switch() */
+  int armed_ticks;       /* Ticks of the quantum armed in tickless mode, 0 if none */
+  int yielding;          /* The running thread leaves the CPU in mythread_yield() */
+  long long idle_since;  /* When the idle thread got the CPU */
+  long long idle_ns;     /* Time spent in the idle thread */
+  long long max_wait[MAX_PRIORITY]; /* Longest wait in the run queue of each priority */
+  TCB idle;              /* Thread control block for the idle thread */
+  pthread_t thread;
+};
+
+static struct worker* workers = NULL;
+static int nworkers = 0;
+static __thread struct worker* self_worker;
+
+/* A green thread can resume on another worker after a context switch, so
+   the TLS pointer must be read again after every switch and never cached */
+static struct worker* __attribute__((noinline, noipa)) self(){
+  return self_worker;
+}
+
+/* The idle thread busy-waits instead of sleeping (MYTHREAD_IDLE=spin) */
+static int idle_spin = 0;
+
+/* Idle workers sleep on this semaphore until new work is queued */
+static sem_t idle_sem;
+static atomic_int idle_workers = 0;
 
 /* Variable indicating if the library is initialized (init == 1) or not (init == 0) */
 static int init=0;
 
-/* Thread control block for the idle thread */
-static TCB idle;
+/* Available scheduling policies and the one in use */
+static struct sched_policy* policies[] = { &sched_rr, &sched_rrf, &sched_rrfd, &sched_ws, &sched_cfs, &sched_mlfq, NULL };
+static struct sched_policy* policy = NULL;
+
+/* Deterministic simulation mode (one worker only, see sim.h): virtual
+   clock and no OS timers. -1 until it is configured */
+static int sim = -1;
+
+/* Memory budget of the block cache, 0 until it is configured */
+static long cache_bytes = 0;
+
+/* Threads parked on a simulated read until the next disk tick. Real
+   reads need no queue: the backend posts them to its completion queue */
+static struct iqueue cola_de_espera;
+static spinlock_t disk_lock = SPINLOCK_INIT;
+/* Wake-ups of the disk waiters, under disk_lock */
+static struct disk_stats wake_stats;
+
+/* Monotonic time in nanoseconds, virtual in simulation mode */
+static long long now_ns(){
+  struct timespec ts;
+
+  if (sim == 1) return sim_now();
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Account for the wake-up of the thread waiting for req, done at now.
+   Called with disk_lock taken */
+static void wake_stat(struct disk_req* req, long long now){
+  long long delay = now - req->done_ns;
+
+  if (delay < 0) delay = 0;
+  wake_stats.woken++;
+  wake_stats.delay_ns += delay;
+  if (delay > wake_stats.max_delay_ns) wake_stats.max_delay_ns = delay;
+}
+
+/* Account for a batch of n wake-ups. Called with disk_lock taken */
+static void batch_stat(int n){
+  wake_stats.batches++;
+  if (n > wake_stats.max_batch) wake_stats.max_batch = n;
+}
+
+/* A read has two parties: its thread, once it is parked off the CPU, and
+   the reaper that takes it from the completion queue. Each one calls this
+   when it is done with the request, and the last one makes the thread
+   ready. Returns 1 for the last one */
+static int handoff(struct disk_req* req){
+  return atomic_fetch_add(&req->handoff, 1) == 1;
+}
+
+/* Threads in mythread_sleep(), by tick of TICK_TIME */
+static struct wheel timers;
+static spinlock_t timer_lock = SPINLOCK_INIT;
+#define TICK_NS (TICK_TIME * 1000LL)
+
+/* Lists of joiners, and the FREE state and generation of the threads
+   they join */
+static spinlock_t join_lock = SPINLOCK_INIT;
+
+/* Number of threads that have not finished */
+static atomic_int live_threads = 0;
+
+/* Critical section around the scheduler state: both the timer and the
+   disk handlers enter the scheduler. It costs no system call (see
+   preempt_disable()). A context switch happens inside it: activator()
+   is called with it taken and the thread that gets the CPU leaves it in
+   finish_switch() */
+static void sched_lock(){
+  preempt_disable();
+}
+
+static void sched_unlock(){
+  preempt_enable();
+}
+
+/* Wake up an idle worker after queueing a ready thread */
+static void kick_idle_worker(){
+  if (nworkers > 1 && atomic_load(&idle_workers) > 0)
+    sem_post(&idle_sem);
+}
+
+/* Tickless mode (one worker only): the clock interrupt comes once at the
+   end of the quantum instead of every TICK_TIME, and not at all while the
+   running thread is the only ready one. -1 until it is configured */
+static int tickless = -1;
+/* Threads queued in the policy, only counted in tickless mode */
+static int nr_ready = 0;
+
+/* Arm the timer for what is left of the quantum of the running thread, or
+   disarm it if no other thread is ready. A thread of the EDF class gets
+   what is left of its budget even when it runs alone. Sleeping threads
+   need every tick to be woken up in time. Called with the scheduler
+   locked */
+static void arm_quantum(struct worker* w){
+  TCB* t = w->running;
+
+  if (edf_thread(t)){
+    long long left = edf_budget_left(t);
+
+    w->armed_ticks = timers.count > 0 || left <= TICK_NS ? 1 : (left + TICK_NS - 1) / TICK_NS;
+    tickless_arm((long) w->armed_ticks * TICK_TIME);
+  } else if (t == &w->idle || nr_ready == 0){
+    w->armed_ticks = 0;
+    tickless_arm(timers.count > 0 ? TICK_TIME : 0);
+  } else {
+    w->armed_ticks = timers.count > 0 ? 1 : t->ticks;
+    tickless_arm((long) w->armed_ticks * TICK_TIME);
+  }
+}
+
+/* Wrappers around the policy hooks that keep nr_ready and put the threads
+   of the EDF class before the ones of the policy. Called with the
+   scheduler locked */
+static void sched_enqueue(TCB* t){
+  if (edf_thread(t)) edf_enqueue(t);
+  else policy->enqueue(t);
+  if (tickless) nr_ready++;
+}
+
+static int reap_disk(struct worker* w);
+static int run_timers(struct worker* w);
+
+static TCB* sched_pick(){
+  TCB* t;
+
+  /* Every scheduling decision first takes the completed reads and the
+     expired sleeps */
+  reap_disk(self());
+  run_timers(self());
+  t = edf_pick_next();
+  if (t == NULL) t = policy->pick_next();
+  if (tickless && t != NULL) nr_ready--;
+  return t;
+}
+
+/* The thread sched_pick() would return, still queued. Policies without a
+   peek hook have it popped and queued again */
+static TCB* sched_peek(){
+  TCB* t;
+
+  reap_disk(self());
+  run_timers(self());
+  t = edf_peek();
+  if (t != NULL) return t;
+  if (policy->peek != NULL) return policy->peek();
+  t = policy->pick_next();
+  if (t != NULL){
+    policy->enqueue(t);
+  }
+  return t;
+}
+
+static int sched_wakeup(struct worker* w, TCB* t){
+  int preempt;
+
+  if (edf_thread(t)){
+    preempt = edf_on_wakeup(w->running, t);
+  } else {
+    /* Nothing in the policy preempts a thread of the EDF class */
+    preempt = policy->on_wakeup(w->running, t) && !edf_thread(w->running);
+  }
+
+  if (tickless){
+    nr_ready++;
+    /* The running thread is no longer alone: start its quantum */
+    if (!preempt && w->armed_ticks == 0) arm_quantum(w);
+  }
+  return preempt;
+}
+
+/* Add the accounting of a thread to s */
+static void stats_add(struct mythread_stats* s, const struct mythread_stats* t){
+  s->run_ns += t->run_ns;
+  s->ready_ns += t->ready_ns;
+  s->blocked_ns += t->blocked_ns;
+  s->dispatches += t->dispatches;
+  s->voluntary += t->voluntary;
+  s->involuntary += t->involuntary;
+  s->jobs += t->jobs;
+  s->misses += t->misses;
+  if (t->max_lateness_ns > s->max_lateness_ns) s->max_lateness_ns = t->max_lateness_ns;
+  if (t->max_ready_ns > s->max_ready_ns) s->max_ready_ns = t->max_ready_ns;
+}
+
+/* Account for the time t spent blocked until it was woken at now. Called
+   with the scheduler locked */
+static void account_wakeup(TCB* t, long long now){
+  t->stats.blocked_ns += now - t->stamp;
+  t->stamp = now;
+}
+
+/* Account for a switch at now from prev to next. Returns how long next
+   was ready. Called with the scheduler locked */
+static long long account_switch(TCB* prev, TCB* next, long long now, int yielding){
+  long long wait = now - next->stamp;
+
+  prev->stats.run_ns += now - prev->stamp;
+  prev->stamp = now;
+  if (prev->state == INIT && !yielding) prev->stats.involuntary++;
+  else if (prev->state != FREE) prev->stats.voluntary++;
+  next->stats.ready_ns += wait;
+  if (wait > next->stats.max_ready_ns) next->stats.max_ready_ns = wait;
+  next->stats.dispatches++;
+  next->stamp = now;
+  return wait;
+}
+
+/* Return a finished TCB to the free list */
+static void tcb_release(TCB* t){
+  spin_lock(&tcb_lock);
+  stats_add(&retired, &t->stats);
+  t->link.next = free_tcbs;
+  free_tcbs = &t->link;
+  spin_unlock(&tcb_lock);
+}
+
+/* Run by a thread as soon as it gets the CPU, with the scheduler still
+   locked by the thread that switched to it. The thread that left the CPU
+   is queued, parked or released only now: until the switch is over its
+   context is not saved and another worker must not resume it */
+static void finish_switch(){
+  struct worker* w = self();
+  TCB* prev = w->prev;
+  int state = FREE;
+
+  w->prev = NULL;
+  if (prev != NULL){
+    state = prev->state;
+    if (state == INIT){
+      sched_enqueue(prev);
+    } else if (state == WAITING){
+      struct disk_req* req = prev->req;
+
+      if (req->fd == DISK_SIM){
+        spin_lock(&disk_lock);
+        tcb_enqueue(&cola_de_espera, prev);
+        spin_unlock(&disk_lock);
+      }
+      if (handoff(req)){
+        /* Its read was reaped before it was parked, maybe by another
+           worker */
+        long long now = now_ns();
+
+        state = prev->state = INIT;
+        account_wakeup(prev, now);
+        spin_lock(&disk_lock);
+        wake_stat(req, now);
+        batch_stat(1);
+        spin_unlock(&disk_lock);
+        sched_enqueue(prev);
+      }
+    } else if (state == BLOCKED){
+      if (prev->park(prev)){
+        /* What it waits for happened while it was leaving the CPU */
+        state = prev->state = INIT;
+        account_wakeup(prev, now_ns());
+        sched_enqueue(prev);
+      }
+    } else if (state == FREE){
+      if (prev->stack != NULL) stack_free(prev->stack, STACKSIZE);
+      tcb_release(prev);
+    }
+  }
+  if (tickless) arm_quantum(w);
+  if (prev != NULL && state == INIT){
+    kick_idle_worker();
+  }
+  sched_unlock();
+}
+
+/* Sleep until a signal comes: the timer and disk interrupts are the only
+   way out of idle with one worker, and their handlers switch to the thread
+   that becomes ready before sigsuspend() returns. The clock interrupt
+   counts CPU time and stops while idle, so with sleeping threads the wait
+   ends after a tick too */
+static void idle_wait(){
+  struct timespec ts = { 0, TICK_NS };
+  sigset_t mask;
+
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+  sigdelset(&mask, SIGVTALRM);
+  sigdelset(&mask, SIGPROF);
+  sigdelset(&mask, SIGIO);
+  if (timers.count > 0){
+    pselect(0, NULL, NULL, NULL, &ts, &mask);
+  } else {
+    sigsuspend(&mask);
+  }
+}
+
+/* The idle thread runs when its worker has nothing else to do. It looks
+   for a ready thread and sleeps between attempts: with one worker until a
+   signal comes (the handler switches to the thread it wakes up), in M:N
+   mode until a thread is queued or for 1 ms, since work can be stolen */
 static void idle_function(){
-  while(1);
+  finish_switch();
+  while(1){
+    struct timespec ts;
+    TCB* next;
+
+    /* A read can complete while its thread is being parked: finish_switch()
+       then makes it ready with no interrupt to come */
+    sched_lock();
+    next = sched_pick();
+    if (next != NULL){
+      activator(next);
+      continue;
+    }
+    sched_unlock();
+    if (sim){
+      /* Nothing runs until the next event */
+      sim_idle();
+      continue;
+    }
+    if (idle_spin) continue;
+    if (nworkers == 1){
+      idle_wait();
+      continue;
+    }
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 1000000;
+    if (ts.tv_nsec >= 1000000000){
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+    atomic_fetch_add(&idle_workers, 1);
+    sem_timedwait(&idle_sem, &ts);
+    atomic_fetch_sub(&idle_workers, 1);
+  }
+}
+
+/* A fault in a guard page is a thread stack overflow: report it and let
+   the fault happen again with the default action */
+static void segv_handler(int sig, siginfo_t* info, void* ctx){
+  char msg[64];
+  int len;
+
+  if (stack_is_guard(info->si_addr)){
+    len = snprintf(msg, sizeof(msg), "*** ERROR: stack overflow in thread %d\n", self()->running->tid);
+    if (write(STDERR_FILENO, msg, len) == -1) {}
+  }
+  signal(SIGSEGV, SIG_DFL);
+}
+
+/* The SIGSEGV handler runs on an alternate stack, one per kernel thread,
+   since the faulting stack is unusable */
+static void init_segv_handler(){
+  struct sigaction sigdat;
+  stack_t ss;
+
+  ss.ss_size = 65536;
+  ss.ss_sp = malloc(ss.ss_size);
+  ss.ss_flags = 0;
+  if(ss.ss_sp == NULL || sigaltstack(&ss, NULL) == -1){
+    perror("sigaltstack");
+    exit(2);
+  }
+  sigdat.sa_sigaction = segv_handler;
+  sigemptyset(&sigdat.sa_mask);
+  sigdat.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  if(sigaction(SIGSEGV, &sigdat, (struct sigaction *)0) == -1){
+    perror("signal set error");
+    exit(2);
+  }
+}
+
+/* Add a slab of free TCBs. Returns -1 if there is no memory */
+static int slab_grow(){
+  TCB* slab;
+  int i;
+
+  if (nslabs == max_slabs){
+    int n = max_slabs ? 2 * max_slabs : 16;
+    TCB** aux = realloc(slabs, n * sizeof(TCB*));
+    if (aux == NULL) return -1;
+    slabs = aux;
+    max_slabs = n;
+  }
+  slab = calloc(SLAB_SIZE, sizeof(TCB));
+  if (slab == NULL) return -1;
+  /* Push them in reverse order so that the lowest tids are handed out first */
+  for (i = SLAB_SIZE - 1; i >= 0; i--){
+    slab[i].state = FREE;
+    slab[i].tid = nslabs * SLAB_SIZE + i;
+    slab[i].link.next = free_tcbs;
+    free_tcbs = &slab[i].link;
+  }
+  slabs[nslabs++] = slab;
+  return 0;
+}
+
+/* Take a free TCB and a stack for it. Returns NULL if there is no memory */
+static TCB* tcb_alloc(){
+  struct queue_link* l = NULL;
+  TCB* t = NULL;
+
+  sched_lock();
+  spin_lock(&tcb_lock);
+  if (free_tcbs != NULL || slab_grow() == 0){
+    l = free_tcbs;
+    free_tcbs = l->next;
+  }
+  spin_unlock(&tcb_lock);
+  if (l != NULL){
+    t = queue_entry(l, TCB, link);
+    spin_lock(&join_lock);
+    t->gen++;
+    spin_unlock(&join_lock);
+    iqueue_init(&t->joiners);
+    memset(&t->stats, 0, sizeof(t->stats));
+    t->stamp = now_ns();
+    t->weight = DEFAULT_WEIGHT;
+    t->vruntime = 0;
+    t->charged = 0;
+    t->level = 0;
+    t->used = 0;
+    t->boost = 0;
+    memset(&t->edf, 0, sizeof(t->edf));
+    t->stack = stack_alloc(STACKSIZE);
+    if (t->stack == NULL){
+      tcb_release(t);
+      t = NULL;
+    }
+  }
+  sched_unlock();
+  return t;
+}
+
+/* Entry point of every new thread */
+static void thread_start(){
+  TCB* t;
+
+  finish_switch();
+  t = self()->running;
+  t->function(t->tid);
+  mythread_exit();
+}
+
+/* Select the policy by name, before the library is initialized */
+static struct sched_policy* find_policy(const char* name){
+  int i;
+  for (i = 0; policies[i] != NULL; i++)
+    if (strcmp(policies[i]->name, name) == 0)
+      return policies[i];
+  return NULL;
+}
+
+/* Prepare the idle thread of a worker. The idle thread of worker 0 gets a
+   stack of its own; the other workers run it on their pthread stack */
+static void init_worker(struct worker* w, int id){
+  w->id = id;
+  w->prev = NULL;
+  w->idle.state = IDLE;
+  w->idle.priority = SYSTEM;
+  w->idle.function = NULL;
+  w->idle.tid = -1;
+  w->idle.ticks = QUANTUM_TICKS;
+  w->idle.stack = NULL;
+  w->running = &w->idle;
+  w->idle_since = now_ns();
+  if (id == 0){
+    w->idle.stack = stack_alloc(STACKSIZE);
+    if(w->idle.stack == NULL){
+      printf("*** ERROR: thread failed to get stack space\n");
+      exit(-1);
+    }
+    ctx_make(&w->idle.run_env, w->idle.stack, stack_round(STACKSIZE), idle_function);
+  }
+}
+
+/* Body of the kernel threads of workers 1..nworkers-1 */
+static void* worker_main(void* arg){
+  struct worker* w = arg;
+
+  self_worker = w;
+  init_segv_handler();
+  init_thread_interrupt();
+  idle_function();
+  return NULL;
 }
 
 /* Initialize the thread library */
 void init_mythreadlib() {
-  int i;  
-  /* Create context for the idle thread */
-  if(getcontext(&idle.run_env) == -1){
-    perror("*** ERROR: getcontext in init_thread_lib");
+  TCB* main_tcb;
+  int i;
+  /* Number of workers: mythread_setworkers(), MYTHREAD_WORKERS or one */
+  if (nworkers == 0){
+    const char* env = getenv("MYTHREAD_WORKERS");
+    nworkers = env ? atoi(env) : 1;
+    if (nworkers < 1) nworkers = 1;
+  }
+  if (getenv("MYTHREAD_IDLE") != NULL && strcmp(getenv("MYTHREAD_IDLE"), "spin") == 0){
+    idle_spin = 1;
+  }
+  /* Tickless mode: mythread_settickless() or MYTHREAD_TICKLESS */
+  if (tickless == -1){
+    const char* env = getenv("MYTHREAD_TICKLESS");
+    tickless = env ? atoi(env) != 0 : 0;
+  }
+  if (tickless && nworkers > 1){
+    printf("*** ERROR: tickless mode needs one worker\n");
     exit(-1);
   }
-  idle.state = IDLE;
-  idle.priority = SYSTEM;
-  idle.function = idle_function;
-  idle.run_env.uc_stack.ss_sp = (void *)(malloc(STACKSIZE));
-  idle.tid = -1;
-  if(idle.run_env.uc_stack.ss_sp == NULL){
-    printf("*** ERROR: thread failed to get stack space\n");
+  /* Simulation mode: mythread_setsim() or MYTHREAD_SIM */
+  if (sim == -1){
+    const char* env = getenv("MYTHREAD_SIM");
+    sim = env ? atoi(env) != 0 : 0;
+  }
+  if (sim && (nworkers > 1 || tickless)){
+    printf("*** ERROR: simulation mode needs one worker and no tickless mode\n");
     exit(-1);
   }
-  idle.run_env.uc_stack.ss_size = STACKSIZE;
-  idle.run_env.uc_stack.ss_flags = 0;
-  idle.ticks = QUANTUM_TICKS;
-  makecontext(&idle.run_env, idle_function, 1); 
-
-  t_state[0].state = INIT;
-  t_state[0].priority = LOW_PRIORITY;
-  t_state[0].ticks = QUANTUM_TICKS;
-  if(getcontext(&t_state[0].run_env) == -1){
-    perror("*** ERROR: getcontext in init_thread_lib");
-    exit(5);
-  }	
+  /* Block cache: mythread_setcache(), MYTHREAD_CACHE_KB or CACHE_SIZE */
+  if (cache_bytes == 0){
+    const char* env = getenv("MYTHREAD_CACHE_KB");
+    cache_bytes = env ? atol(env) * 1024 : CACHE_SIZE;
+  }
+  if (cache_init(cache_bytes) == -1){
+    printf("*** ERROR: no memory for the block cache\n");
+    exit(-1);
+  }
+  /* Pick the scheduling policy: mythread_setpolicy(), MYTHREAD_POLICY or the default one */
+  if (policy == NULL){
+    const char* name = getenv("MYTHREAD_POLICY");
+    if (name == NULL) name = nworkers > 1 ? "ws" : DEFAULT_POLICY;
+    policy = find_policy(name);
+    if (policy == NULL){
+      printf("*** ERROR: unknown scheduling policy %s\n", name);
+      exit(-1);
+    }
+  }
+  if (nworkers > 1 && !policy->smp){
+    printf("*** ERROR: scheduling policy %s does not support %d workers\n", policy->name, nworkers);
+    exit(-1);
+  }
+  workers = calloc(nworkers, sizeof(struct worker));
+  if (workers == NULL || sem_init(&idle_sem, 0, 0) == -1){
+    printf("*** ERROR: no memory for the workers\n");
+    exit(-1);
+  }
+  for (i = 0; i < nworkers; i++){
+    init_worker(&workers[i], i);
+  }
+  self_worker = &workers[0];
+#ifdef MYTHREAD_TRACE
+  trace_init();
+#endif
+  policy->init();
+  edf_init();
+  iqueue_init(&cola_de_espera);
+  wheel_init(&timers, now_ns() / TICK_NS);
 
-  for(i=1; i<N; i++){
-    t_state[i].state = FREE;
+  /* The main thread takes the first TCB, tid 0 */
+  main_tcb = tcb_alloc();
+  if(main_tcb == NULL){
+    printf("*** ERROR: no memory for the thread table\n");
+    exit(-1);
   }
- 
-  t_state[0].tid = 0;
-  running = &t_state[0];
+  main_tcb->state = INIT;
+  main_tcb->priority = LOW_PRIORITY;
+  main_tcb->ticks = QUANTUM_TICKS;
+  /* The main thread runs on the process stack. Its context is saved the
+     first time it leaves the CPU */
+  stack_free(main_tcb->stack, STACKSIZE);
+  main_tcb->stack = NULL;
+  atomic_store(&live_threads, 1);
+  workers[0].running = main_tcb;
 
-  /* Initialize disk and clock interrupts */
+  init_segv_handler();
+
+  /* Initialize disk and clock interrupts, virtual ones in simulation mode */
+  if (sim){
+    sim_event(TICK_TIME * 1000LL, TICK_TIME * 1000LL, timer_interrupt, SIGVTALRM);
+    sim_event(DISK_TIME * 1000LL, DISK_TIME * 1000LL, disk_interrupt, SIGPROF);
+    return;
+  }
+  init_io_interrupt();
+  if (tickless){
+    init_tickless_interrupt();
+    return;
+  }
   init_disk_interrupt();
-  init_interrupt();
+  if (nworkers == 1){
+    init_interrupt();
+    return;
+  }
+  init_thread_interrupt();
+  for (i = 1; i < nworkers; i++){
+    if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0){
+      printf("*** ERROR: cannot start worker %d\n", i);
+      exit(-1);
+    }
+  }
 }
 
 
-/* Create and intialize a new thread with body fun_addr and one integer argument */ 
-int mythread_create (void (*fun_addr)(),int priority)
+/* Select the scheduling policy ("rr", "rrf", "rrfd", "ws", "cfs" or "mlfq").
+   It must be called before any other function of the library. Returns 0 on
+   success and -1 if the policy does not exist or the library is already
+   initialized */
+int mythread_setpolicy(const char* name)
+{
+  struct sched_policy* p = find_policy(name);
+
+  if (init || p == NULL) return(-1);
+  policy = p;
+  return 0;
+}
+
+/* Returns the name of the scheduling policy in use */
+const char* mythread_getpolicy()
+{
+  if (!init) { init_mythreadlib(); init=1;}
+  return policy->name;
+}
+
+/* Run the green threads on n kernel threads (M:N mode). It must be called
+   before any other function of the library. Returns 0 on success and -1 if
+   n is not valid or the library is already initialized */
+int mythread_setworkers(int n)
+{
+  if (init || n < 1) return(-1);
+  nworkers = n;
+  return 0;
+}
+
+/* Enable (on != 0) or disable the tickless mode, where the clock interrupt
+   only comes at the end of a quantum. It must be called before any other
+   function of the library and needs one worker. Returns 0 on success and
+   -1 if the library is already initialized */
+int mythread_settickless(int on)
+{
+  if (init) return(-1);
+  tickless = on != 0;
+  return 0;
+}
+
+/* Enable (on != 0) or disable the deterministic simulation mode, where the
+   clock and disk interrupts come from a virtual clock that advances with
+   mythread_compute(). It must be called before any other function of the
+   library and needs one worker. Returns 0 on success and -1 if the library
+   is already initialized */
+int mythread_setsim(int on)
+{
+  if (init) return(-1);
+  sim = on != 0;
+  return 0;
+}
+
+/* Compute for usec microseconds. In simulation mode the virtual clock
+   advances and the interrupts that fall in it are fired; otherwise the
+   thread busy-waits until it has been on the CPU that long */
+void mythread_compute(long usec)
+{
+  long long left = usec * 1000LL;
+  long long last, now;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  if (sim){
+    sim_advance(left);
+    return;
+  }
+  /* A gap of more than a tick between two reads of the clock is time the
+     thread spent off the CPU */
+  last = now_ns();
+  while (left > 0){
+    now = now_ns();
+    if (now - last < TICK_TIME * 1000LL) left -= now - last;
+    last = now;
+  }
+}
+
+/* Set the memory budget of the block cache of read_disk() in bytes. It
+   must be called before any other function of the library. Returns 0 on
+   success and -1 if the library is already initialized */
+int mythread_setcache(long bytes)
+{
+  if (init || bytes <= 0) return(-1);
+  cache_bytes = bytes;
+  return 0;
+}
+
+/* Wake-ups of the threads that waited for the disk: how many, in how
+   many batches, and the delay from the completion of a read to the
+   wake-up of its thread */
+void mythread_diskstats(struct disk_stats* s)
+{
+  if (!init) { init_mythreadlib(); init=1;}
+  sched_lock();
+  spin_lock(&disk_lock);
+  *s = wake_stats;
+  spin_unlock(&disk_lock);
+  sched_unlock();
+}
+
+/* Find the TCB of a thread that has not finished. Returns NULL if there
+   is none with that tid. Called with tcb_lock taken */
+static TCB* tcb_lookup(int tid){
+  TCB* t;
+
+  if (tid < 0 || tid >= nslabs * SLAB_SIZE) return NULL;
+  t = &slabs[tid / SLAB_SIZE][tid % SLAB_SIZE];
+  return t->state == FREE ? NULL : t;
+}
+
+/* Add to s the accounting of t, with the interval it is in now */
+static void stats_current(struct mythread_stats* s, TCB* t, long long now){
+  struct mythread_stats cur = t->stats;
+  long long open = now - t->stamp;
+  int i;
+
+  if (t->state == WAITING || t->state == BLOCKED){
+    cur.blocked_ns += open;
+  } else {
+    for (i = 0; i < nworkers && workers[i].running != t; i++);
+    if (i < nworkers){
+      cur.run_ns += open;
+    } else {
+      cur.ready_ns += open;
+      if (open > cur.max_ready_ns) cur.max_ready_ns = open;
+    }
+  }
+  stats_add(s, &cur);
+}
+
+/* Scheduling accounting of thread tid: time on the CPU, ready and blocked,
+   and how many times it left the CPU blocking or preempted. With
+   MYTHREAD_ALL, the sum over every thread that ever ran. Returns 0 on
+   success and -1 if tid does not exist. Threads on other workers keep
+   running, so their figures are a snapshot */
+int mythread_getstats(int tid, struct mythread_stats* s)
+{
+  long long now;
+  TCB* t;
+  int i, rc = 0;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  memset(s, 0, sizeof(*s));
+  sched_lock();
+  spin_lock(&tcb_lock);
+  now = now_ns();
+  if (tid == MYTHREAD_ALL){
+    stats_add(s, &retired);
+    for (i = 0; i < nslabs * SLAB_SIZE; i++){
+      t = tcb_lookup(i);
+      if (t != NULL) stats_current(s, t, now);
+    }
+  } else if ((t = tcb_lookup(tid)) != NULL){
+    stats_current(s, t, now);
+  } else {
+    rc = -1;
+  }
+  spin_unlock(&tcb_lock);
+  sched_unlock();
+  return rc;
+}
+
+/* Hits, misses and evictions of the block cache */
+void mythread_cachestats(struct cache_stats* s)
 {
+  if (!init) { init_mythreadlib(); init=1;}
+  cache_get_stats(s);
+}
+
+/* Returns the time in nanoseconds the workers have spent in their idle
+   thread, added over all of them */
+long long mythread_idletime()
+{
+  long long ns = 0;
   int i;
-  
+
   if (!init) { init_mythreadlib(); init=1;}
-  for (i=0; i<N; i++)
-    if (t_state[i].state == FREE) break;
-  if (i == N) return(-1);
-  if(getcontext(&t_state[i].run_env) == -1){
-    perror("*** ERROR: getcontext in my_thread_create");
-    exit(-1);
+  for (i = 0; i < nworkers; i++){
+    ns += workers[i].idle_ns;
+    if (workers[i].running == &workers[i].idle)
+      ns += now_ns() - workers[i].idle_since;
   }
-  t_state[i].state = INIT;
-  t_state[i].priority = priority;
-  t_state[i].function = fun_addr;
-  t_state[i].run_env.uc_stack.ss_sp = (void *)(malloc(STACKSIZE));
-  if(t_state[i].run_env.uc_stack.ss_sp == NULL){
-    printf("*** ERROR: thread failed to get stack space\n");
-    exit(-1);
+  return ns;
+}
+
+/* Longest time a thread of the given priority waited in the run queue,
+   over all workers, in nanoseconds */
+long long mythread_maxwait(int priority)
+{
+  long long max = 0;
+  int i;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  if (priority < 0 || priority >= MAX_PRIORITY) return -1;
+  for (i = 0; i < nworkers; i++)
+    if (workers[i].max_wait[priority] > max) max = workers[i].max_wait[priority];
+  return max;
+}
+
+long long sched_now(){
+  return now_ns();
+}
+
+int sched_nworkers(){
+  return nworkers;
+}
+
+int sched_worker_id(){
+  return self()->id;
+}
+
+
+/* Make ready a new thread. Returns its tid */
+static int thread_ready(TCB* t){
+  int preempt;
+
+  t->state = INIT;
+  t->req = NULL;
+  ctx_make(&t->run_env, t->stack, stack_round(STACKSIZE), thread_start);
+  atomic_fetch_add(&live_threads, 1);
+
+  sched_lock();
+  preempt = sched_wakeup(self(), t);
+  kick_idle_worker();
+  if (preempt){
+    activator(scheduler());
+  } else {
+    sched_unlock();
   }
-  t_state[i].tid = i;
-  t_state[i].run_env.uc_stack.ss_size = STACKSIZE;
-  t_state[i].run_env.uc_stack.ss_flags = 0;
-  makecontext(&t_state[i].run_env, fun_addr, 1); 
-  return i;
+  return t->tid;
+}
+
+/* Create and intialize a new thread with body fun_addr and one integer argument */
+int mythread_create (void (*fun_addr)(),int priority)
+{
+  TCB* t;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  if (priority < 0 || priority >= MAX_PRIORITY) return(-1);
+  t = tcb_alloc();
+  if (t == NULL) return(-1);
+  t->priority = priority;
+  t->ticks = QUANTUM_TICKS;
+  t->function = fun_addr;
+  return thread_ready(t);
 } /****** End my_thread_create() ******/
 
-/* Read disk syscall */
-int read_disk()
+/* Create a thread of the EDF class (see EDF.c): a job is released every
+   period microseconds, may use budget microseconds of CPU and should end
+   with mythread_wait_period() within deadline microseconds of its release.
+   The first job is released now. Returns the tid, or -1 if budget <=
+   deadline <= period does not hold, the reservation does not fit in the
+   CPU left to the class or there is more than one worker */
+int mythread_create_deadline(void (*fun_addr)(), long period, long budget, long deadline)
 {
-   return 1;
+  int rc;
+  TCB* t;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  if (nworkers > 1) return(-1);
+  t = tcb_alloc();
+  if (t == NULL) return(-1);
+  sched_lock();
+  rc = edf_admit(t, period * 1000LL, budget * 1000LL, deadline * 1000LL);
+  if (rc == -1){
+    stack_free(t->stack, STACKSIZE);
+    tcb_release(t);
+  }
+  sched_unlock();
+  if (rc == -1) return(-1);
+  /* The priority only matters to the comparisons of the core, like the
+     one of mythread_yield() */
+  t->priority = MAX_PRIORITY - 1;
+  t->ticks = QUANTUM_TICKS;
+  t->function = fun_addr;
+  return thread_ready(t);
+}
+
+/* Block the running thread until req completes: a real read when the
+   backend posts its completion, a simulated one at the next disk interrupt */
+static void wait_disk(struct disk_req* req){
+  struct worker* w;
+  int preempt;
+  TCB* t;
+
+  sched_lock();
+  w = self();
+  t = w->running;
+  req->waiter = t;
+  /* The read may be done already: then the reaper is the first party and
+     the thread need not block */
+  preempt = reap_disk(w);
+  if (atomic_load(&req->handoff) == 1){
+    if (preempt){
+      activator(scheduler());
+    } else {
+      sched_unlock();
+    }
+    return;
+  }
+  sched_event(TRACE_BLOCK, t->tid, 0, "*** THREAD %d READ FROM DISK\n", t->tid);
+  t->req = req;
+  t->state = WAITING;
+  if (policy->on_block != NULL) policy->on_block(t);
+  activator(scheduler());
+  t->req = NULL;
+}
+
+/* Read from the disk, blocking only the calling thread if the policy
+   allows it */
+static ssize_t disk_read(int fd, off_t offset, void* buf, size_t len){
+  struct disk_req req;
+
+  /* The backend completes reads at real times, which would break the
+     determinism of the simulation */
+  if (!policy->disk || sim || disk_init() == -1){
+    return pread(fd, buf, len, offset);
+  }
+  req.fd = fd;
+  req.offset = offset;
+  req.buf = buf;
+  req.len = len;
+  if (disk_submit(&req) == -1){
+    return pread(fd, buf, len, offset);
+  }
+  wait_disk(&req);
+  if (req.result < 0){
+    errno = -req.result;
+    return -1;
+  }
+  return req.result;
+}
+
+/* Read disk syscall. Reads len bytes of fd at offset like pread(), and
+   returns what pread() would. The blocks found in the cache are copied
+   from it; from the first missing one on the calling thread waits for the
+   disk and the others go on running. With fd DISK_SIM nothing is read
+   and it returns 1: the thread waits for the disk interrupt if the blocks
+   are not in the cache */
+ssize_t read_disk(int fd, off_t offset, void* buf, size_t len)
+{
+  struct stat st;
+  dev_t dev = 0;
+  ino_t ino = 0;
+  long first, last, b;
+  off_t start, from, to;
+  ssize_t n;
+  char* bounce;
+  long i;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  if (fd == DISK_SIM){
+    if(!policy->disk){
+      return 1;
+    }
+  } else {
+    if (fstat(fd, &st) == -1) return -1;
+    dev = st.st_dev;
+    ino = st.st_ino;
+  }
+
+  first = offset / CACHE_BLOCK;
+  last = len > 0 ? (offset + len - 1) / CACHE_BLOCK : first;
+  for (b = first; b <= last; b++){
+    start = (off_t) b * CACHE_BLOCK;
+    from = start > offset ? start : offset;
+    to = start + CACHE_BLOCK < offset + (off_t) len ? start + CACHE_BLOCK : offset + (off_t) len;
+    if (!cache_read(dev, ino, b, from - start, buf ? (char*) buf + (from - offset) : NULL, to - from)) break;
+  }
+  if (b > last){
+    return fd == DISK_SIM ? 1 : len;
+  }
+
+  /* Blocks b..last are read whole and cached, and each one is a miss */
+  cache_miss(last - b);
+  if (fd == DISK_SIM){
+    struct disk_req req;
+
+    req.fd = DISK_SIM;
+    atomic_init(&req.done, 0);
+    atomic_init(&req.handoff, 0);
+    wait_disk(&req);
+    for (; b <= last; b++) cache_insert(0, 0, b, NULL);
+    return 1;
+  }
+  start = (off_t) b * CACHE_BLOCK;
+  /* A thread preempted with the lock of the malloc arena would block the
+     others of its worker that allocate */
+  preempt_disable();
+  bounce = malloc((last - b + 1) * CACHE_BLOCK);
+  preempt_enable();
+  if (bounce == NULL) return -1;
+  n = disk_read(fd, start, bounce, (last - b + 1) * CACHE_BLOCK);
+  if (n == -1){
+    preempt_disable();
+    free(bounce);
+    preempt_enable();
+    return -1;
+  }
+  /* A partial block at the end of the file is not cached */
+  for (i = 0; (i + 1) * CACHE_BLOCK <= n; i++){
+    cache_insert(dev, ino, b + i, bounce + i * CACHE_BLOCK);
+  }
+  from = start > offset ? start : offset;
+  to = start + n < offset + (off_t) len ? start + n : offset + (off_t) len;
+  if (to > from){
+    memcpy((char*) buf + (from - offset), bounce + (from - start), to - from);
+  }
+  preempt_disable();
+  free(bounce);
+  preempt_enable();
+  return to > offset ? to - offset : 0;
+}
+
+/* Make ready the BLOCKED threads of the queue q, which are off the CPU.
+   Called with the scheduler locked. Returns 1 if one must preempt the
+   running thread */
+static int wake_all(struct worker* w, struct iqueue* q){
+  long long now = now_ns();
+  int preempt = 0;
+  TCB* t;
+
+  if (iqueue_empty(q)) return 0;
+  while ((t = tcb_dequeue(q)) != NULL){
+    t->state = INIT;
+    account_wakeup(t, now);
+    sched_event(TRACE_READY, t->tid, 0, "*** THREAD %d READY\n", t->tid);
+    preempt |= sched_wakeup(w, t);
+  }
+  kick_idle_worker();
+  return preempt;
+}
+
+/* Wake the sleeping threads whose time has come. Called with the
+   scheduler locked at every scheduling decision and clock tick. Returns 1
+   if one must preempt the running thread */
+static int run_timers(struct worker* w){
+  struct iqueue expired, ready;
+  struct queue_link* l;
+
+  if (timers.count == 0) return 0;
+  iqueue_init(&expired);
+  iqueue_init(&ready);
+  spin_lock(&timer_lock);
+  wheel_advance(&timers, now_ns() / TICK_NS, &expired);
+  spin_unlock(&timer_lock);
+  while ((l = iqueue_pop(&expired)) != NULL){
+    tcb_enqueue(&ready, queue_entry(l, TCB, timer.link));
+  }
+  return wake_all(w, &ready);
+}
+
+/* Make ready the threads whose reads are in the completion queue. Called
+   with the scheduler locked, at every scheduling decision and from the
+   disk interrupt. All of them are woken in one batch. Returns 1 if one
+   must preempt the running thread */
+static int reap_disk(struct worker* w){
+  struct iqueue done, ready;
+  struct queue_link* l;
+  long long now;
+  int preempt = 0;
+  int n = 0;
+  TCB* t;
+
+  iqueue_init(&done);
+  if (disk_reap(&done) == 0) return 0;
+  iqueue_init(&ready);
+  now = now_ns();
+  spin_lock(&disk_lock);
+  while ((l = iqueue_pop(&done)) != NULL){
+    struct disk_req* req = queue_entry(l, struct disk_req, link);
+
+    /* If its thread is not parked yet, it wakes itself in finish_switch()
+       and req must not be touched any more */
+    if (handoff(req)){
+      wake_stat(req, now);
+      tcb_enqueue(&ready, req->waiter);
+      n++;
+    }
+  }
+  if (n > 0) batch_stat(n);
+  spin_unlock(&disk_lock);
+
+  while ((t = tcb_dequeue(&ready)) != NULL){
+    t->state = INIT;
+    account_wakeup(t, now);
+    sched_event(TRACE_READY, t->tid, 0, "*** THREAD %d READY\n", t->tid);
+    preempt |= sched_wakeup(w, t);
+  }
+  if (n > 0) kick_idle_worker();
+  return preempt;
 }
 
-/* Disk interrupt  */
+/* Disk interrupt. The disk timer (SIGPROF) completes every simulated
+   read parked before it, and the backend sends SIGIO after it posts real
+   completions. Completions only go through the lock-free completion
+   queue; they are reaped here and at the next scheduling decision */
 void disk_interrupt(int sig)
 {
-} 
+  struct worker* w;
+  long long now;
+  int preempt;
+  TCB* t;
+
+  if (!init) return;
+
+  sched_lock();
+  w = self();
+  if (sig != SIGIO && !iqueue_empty(&cola_de_espera)){
+    now = now_ns();
+    spin_lock(&disk_lock);
+    while ((t = tcb_dequeue(&cola_de_espera)) != NULL){
+      t->req->done_ns = now;
+      atomic_store(&t->req->done, 1);
+      disk_post(t->req);
+    }
+    spin_unlock(&disk_lock);
+  }
+  preempt = reap_disk(w);
+
+  /* The idle thread always leaves the CPU to a ready thread */
+  if (preempt || w->running == &w->idle){
+    activator(scheduler());
+  } else {
+    sched_unlock();
+  }
+}
 
 
 /* Free terminated thread and exits */
 void mythread_exit() {
-  int tid = mythread_gettid();	
+  struct iqueue joiners;
+  TCB* t;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  sched_lock();
+  t = self()->running;
+  sched_event(TRACE_FINISHED, t->tid, 0, "*** THREAD %d FINISHED\n", t->tid);
+  if (edf_thread(t)) edf_leave(t);
+  if (atomic_fetch_sub(&live_threads, 1) == 1){
+    printf("*** IDLE TIME %.3f s\n", mythread_idletime() / 1e9);
+    {
+      struct mythread_stats st;
+      spin_lock(&tcb_lock);
+      st = retired;
+      stats_current(&st, t, now_ns());
+      spin_unlock(&tcb_lock);
+      printf("*** RUN %.3f s READY %.3f s (MAX %.3f ms) BLOCKED %.3f s, %ld VOLUNTARY %ld INVOLUNTARY SWITCHES\n",
+             st.run_ns / 1e9, st.ready_ns / 1e9, st.max_ready_ns / 1e6, st.blocked_ns / 1e9,
+             st.voluntary, st.involuntary);
+      if (st.jobs > 0){
+        printf("*** EDF %ld JOBS %ld MISSES (MAX LATENESS %.3f ms)\n",
+               st.jobs, st.misses, st.max_lateness_ns / 1e6);
+      }
+    }
+    {
+      int p;
+      printf("*** MAX READY WAIT");
+      for (p = MAX_PRIORITY - 1; p >= 0; p--){
+        if (mythread_maxwait(p) > 0) printf(" PRIORITY %d %.3f ms", p, mythread_maxwait(p) / 1e6);
+      }
+      printf("\n");
+    }
+    {
+      struct cache_stats cs;
+      cache_get_stats(&cs);
+      printf("*** CACHE %ld HITS %ld MISSES %ld EVICTIONS\n", cs.hits, cs.misses, cs.evictions);
+    }
+    if (wake_stats.batches > 0){
+      printf("*** DISK %ld WAKEUPS IN %ld BATCHES (MAX %ld), DELAY AVG %.1f us MAX %.1f us\n",
+             wake_stats.woken, wake_stats.batches, wake_stats.max_batch,
+             wake_stats.delay_ns / 1e3 / wake_stats.woken, wake_stats.max_delay_ns / 1e3);
+    }
+    printf("*** FINISH\n");
+    exit(1);
+  }
+  /* The stack and the TCB are released once we have switched to another
+     thread. Its joiners can go on */
+  spin_lock(&join_lock);
+  t->state = FREE;
+  joiners = t->joiners;
+  iqueue_init(&t->joiners);
+  spin_unlock(&join_lock);
+  wake_all(self(), &joiners);
 
-  printf("*** THREAD %d FINISHED\n", tid);	
-  t_state[tid].state = FREE;
-  free(t_state[tid].run_env.uc_stack.ss_sp); 
+  activator(scheduler());
+}
+
+/* Give the CPU to the next ready thread, which the policy picks, and go
+   back to the run queue. A thread of lower priority than the caller does
+   not get it: the caller goes on, and that thread keeps its place */
+void mythread_yield()
+{
+  struct worker* w;
+  TCB* next;
 
-  TCB* next = scheduler();
+  if (!init) { init_mythreadlib(); init=1;}
+  sched_lock();
+  w = self();
+  next = sched_peek();
+  if (next != NULL && next->priority >= w->running->priority){
+    /* Another worker may steal it in between */
+    next = sched_pick();
+  } else {
+    next = NULL;
+  }
+  if (next == NULL){
+    sched_unlock();
+    return;
+  }
+  w->yielding = 1;
   activator(next);
 }
 
-/* Sets the priority of the calling thread */
-void mythread_setpriority(int priority) {
-  int tid = mythread_gettid();	
-  t_state[tid].priority = priority;
+/* Block the running thread until park() or a wake-up makes it ready.
+   Called with the scheduler locked */
+static void block(TCB* t, int (*park)(TCB* t), void* wait){
+  t->park = park;
+  t->wait = wait;
+  t->state = BLOCKED;
+  activator(scheduler());
+}
+
+/* Put a joiner in the list of the thread it joins, unless that one has
+   finished already */
+static int park_join(TCB* t){
+  TCB* target = t->wait;
+  int done;
+
+  spin_lock(&join_lock);
+  done = target->gen != t->wait_gen || target->state == FREE;
+  if (!done) tcb_enqueue(&target->joiners, t);
+  spin_unlock(&join_lock);
+  return done;
+}
+
+/* Wait for the thread tid to finish. Returns 0 when it has finished, and
+   -1 if there is no thread tid running or it is the caller */
+int mythread_join(int tid)
+{
+  TCB* t;
+  TCB* target;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  sched_lock();
+  t = self()->running;
+  spin_lock(&tcb_lock);
+  target = tcb_lookup(tid);
+  spin_unlock(&tcb_lock);
+  if (target == NULL || target == t){
+    sched_unlock();
+    return(-1);
+  }
+  spin_lock(&join_lock);
+  t->wait_gen = target->gen;
+  spin_unlock(&join_lock);
+  block(t, park_join, target);
+  return 0;
+}
+
+/* Put a sleeping thread in the timer wheel */
+static int park_sleep(TCB* t){
+  spin_lock(&timer_lock);
+  /* An empty wheel is not advanced: bring it to the current tick first */
+  if (timers.count == 0) timers.next = now_ns() / TICK_NS;
+  wheel_add(&timers, &t->timer);
+  spin_unlock(&timer_lock);
+  return 0;
+}
+
+/* Block the calling thread for usec microseconds at least. It wakes up at
+   a clock tick, so the time is rounded up to TICK_TIME */
+void mythread_sleep(long usec)
+{
+  TCB* t;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  if (usec <= 0){
+    mythread_yield();
+    return;
+  }
+  sched_lock();
+  t = self()->running;
+  t->timer.expires = (now_ns() + usec * 1000LL + TICK_NS - 1) / TICK_NS;
+  block(t, park_sleep, NULL);
+}
+
+/* Block the running thread of the EDF class until t->edf.release, when its
+   next job or budget comes. Called with the scheduler locked */
+static void edf_sleep(TCB* t){
+  t->timer.expires = (t->edf.release + TICK_NS - 1) / TICK_NS;
+  block(t, park_sleep, NULL);
+}
+
+/* End the current job of the calling thread of the EDF class and wait for
+   the release of the next one. If it is already due it starts at once.
+   Returns 0, or -1 if the caller is not in the EDF class */
+int mythread_wait_period()
+{
+  TCB* t;
+  int r;
+
+  if (!init) { init_mythreadlib(); init=1;}
+  sched_lock();
+  t = self()->running;
+  if (!edf_thread(t)){
+    sched_unlock();
+    return(-1);
+  }
+  r = edf_complete(t);
+  if (r == EDF_SLEEP){
+    edf_sleep(t);
+  } else if (r){
+    activator(scheduler());
+  } else {
+    /* A new budget */
+    if (tickless) arm_quantum(self());
+    sched_unlock();
+  }
+  return 0;
+}
+
+/* Block the running thread on a synchronization object, see sched.h */
+void sched_block(int (*park)(TCB* t), void* wait){
+  if (!init) { init_mythreadlib(); init=1;}
+  sched_lock();
+  block(self()->running, park, wait);
+}
+
+int sched_wake(TCB* t){
+  struct iqueue q;
+
+  iqueue_init(&q);
+  tcb_enqueue(&q, t);
+  return wake_all(self(), &q);
+}
+
+void sched_preempt(){
+  sched_lock();
+  activator(scheduler());
+}
+
+void sched_handoff(TCB* t){
+  struct worker* w;
+  TCB* next = NULL;
+  int preempt;
+
+  sched_lock();
+  w = self();
+  /* The policy sees the wake-up as any other, and t only gets the CPU
+     straight away if it is the one the policy would pick next */
+  preempt = sched_wake(t);
+  if (t->priority >= w->running->priority && sched_peek() == t){
+    next = sched_pick();
+  }
+  if (next != NULL){
+    w->yielding = 1;
+    activator(next);
+  } else if (preempt){
+    activator(scheduler());
+  } else {
+    sched_unlock();
+  }
+}
+
+/* Sets the priority of the calling thread, from 0 to MAX_PRIORITY-1 */
+int mythread_setpriority(int priority) {
+  if (!init) { init_mythreadlib(); init=1;}
+  if (priority < 0 || priority >= MAX_PRIORITY) return(-1);
+  self()->running->priority = priority;
+  return 0;
+}
+
+/* Sets the weight of the calling thread, from 1 to MAX_WEIGHT */
+int mythread_setweight(int weight) {
+  if (!init) { init_mythreadlib(); init=1;}
+  if (weight < 1 || weight > MAX_WEIGHT) return(-1);
+  sched_lock();
+  if (policy == &sched_cfs) cfs_setweight(self()->running, weight);
+  else self()->running->weight = weight;
+  sched_unlock();
+  return 0;
+}
+
+/* Returns the weight of the calling thread */
+int mythread_getweight() {
+  if (!init) { init_mythreadlib(); init=1;}
+  return self()->running->weight;
 }
 
 /* Returns the priority of the calling thread */
 int mythread_getpriority(int priority) {
-  int tid = mythread_gettid();	
-  return t_state[tid].priority;
+  if (!init) { init_mythreadlib(); init=1;}
+  return self()->running->priority;
 }
 
 
 /* Get the current thread id.  */
 int mythread_gettid(){
   if (!init) { init_mythreadlib(); init=1;}
-  return current;
+  return self()->running->tid;
 }
 
 
-/* FIFO para alta prioridad, RR para baja*/
+/* Ask the policy for the next thread to run. When there is none the
+   running thread goes on, or the idle thread runs if it left the CPU.
+   Called with the scheduler locked */
 TCB* scheduler(){
-  int i;
-  for(i=0; i<N; i++){
-    if (t_state[i].state == INIT) {
-        current = i;
-	return &t_state[i];
-    }
+  struct worker* w = self();
+  TCB* next;
+
+  next = sched_pick();
+  if (next != NULL){
+    return next;
   }
-  printf("mythread_free: No thread in the system\nExiting...\n");	
-  exit(1); 
+  if (w->running->state==INIT){
+    return w->running;
+  }
+  return &w->idle;
 }
 
 
 /* Timer interrupt  */
 void timer_interrupt(int sig)
 {
-} 
+  struct worker* w;
+  int preempt;
 
-/* Activator */
-void activator(TCB* next){
-  setcontext (&(next->run_env));
-  printf("mythread_free: After setcontext, should never get here!!...\n");	
+  if (!init) return;
+  sched_lock();
+  w = self();
+  if (w->running == &w->idle){
+    sched_unlock();
+    return;
+  }
+  preempt = run_timers(w);
+  if (edf_thread(w->running)){
+    /* The budget is charged by time, not by ticks */
+    int r = edf_on_tick(w->running);
+
+    w->armed_ticks = 0;
+    if (r == EDF_SLEEP){
+      edf_sleep(w->running);
+      return;
+    }
+    preempt |= r;
+    if (tickless && !preempt) arm_quantum(w);
+  } else if (tickless){
+    /* The armed quantum is over: account for all its ticks at once */
+    int i, n = w->armed_ticks;
+
+    w->armed_ticks = 0;
+    for (i = 0; i < n && !preempt; i++){
+      preempt = policy->on_tick(w->running);
+    }
+    if (!preempt) arm_quantum(w);
+  } else {
+    preempt |= policy->on_tick(w->running);
+  }
+  if (preempt){
+    activator(scheduler());
+  } else {
+    sched_unlock();
+  }
 }
 
+/* Activator: switch to next. Called with the scheduler locked, which is
+   left by finish_switch() in the thread that gets the CPU, or here if next
+   is already running */
+void activator(TCB* next){
+  struct worker* w = self();
+  TCB* anterior = w->running;
+  int yielding = w->yielding;
+  long long now, wait;
+
+  w->yielding = 0;
+  anterior->ticks= QUANTUM_TICKS;
+  if (anterior == next){
+    /* Still running: the policy had nothing better */
+    if (tickless) arm_quantum(w);
+    sched_unlock();
+    return;
+  }
+  w->running = next;
+  w->prev = anterior;
+  now = now_ns();
+  wait = account_switch(anterior, next, now, yielding);
+  if (next != &w->idle && next->priority < MAX_PRIORITY && wait > w->max_wait[next->priority])
+    w->max_wait[next->priority] = wait;
+  if (anterior == &w->idle) w->idle_ns += now - w->idle_since;
+  if (next == &w->idle) w->idle_since = now;
 
+  if (anterior->state == FREE){
+    sched_event(TRACE_TERMINATED, anterior->tid, next->tid,
+                "*** THREAD %d TERMINATED: SET CONTEXT OF %d\n", anterior->tid, next->tid);
+    ctx_jump(&next->run_env);
+    printf("mythread_free: After setcontext, should never get here!!...\n");
+  }
 
+  if (anterior->state == INIT && next->priority > anterior->priority){
+    sched_event(TRACE_PREEMPT, anterior->tid, next->tid,
+                "*** THREAD %d PREEMTED: SET CONTEXT OF %d\n", anterior->tid, next->tid);
+  } else {
+    sched_event(TRACE_SWITCH, anterior->tid, next->tid,
+                "*** SWAPCONTEXT FROM %d TO %d\n", anterior->tid, next->tid);
+  }
+  ctx_switch(&anterior->run_env, &next->run_env);
+  finish_switch();
+}
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pheap.h"
+
+/* Link two trees: the root with the larger key becomes the first child
+   of the other */
+static struct pheap_node* meld(struct pheap_node* a, struct pheap_node* b)
+{
+  struct pheap_node* t;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (b->key < a->key) {
+    t = a;
+    a = b;
+    b = t;
+  }
+  b->sibling = a->child;
+  a->child = b;
+  return a;
+}
+
+void pheap_push(struct pheap* h, struct pheap_node* n)
+{
+  n->child = NULL;
+  n->sibling = NULL;
+  h->root = meld(h->root, n);
+  h->count++;
+}
+
+struct pheap_node* pheap_pop(struct pheap* h)
+{
+  struct pheap_node* min = h->root;
+  struct pheap_node *pairs = NULL, *a, *b, *next;
+
+  if (min == NULL)
+    return NULL;
+  /* First pass: meld the children in pairs, left to right, keeping the
+     pairs in a list linked through sibling (in reverse order) */
+  for (a = min->child; a != NULL; a = next) {
+    b = a->sibling;
+    next = b ? b->sibling : NULL;
+    a->sibling = NULL;
+    if (b != NULL)
+      b->sibling = NULL;
+    a = meld(a, b);
+    a->sibling = pairs;
+    pairs = a;
+  }
+  /* Second pass: meld the pairs right to left into one tree */
+  h->root = NULL;
+  for (a = pairs; a != NULL; a = next) {
+    next = a->sibling;
+    a->sibling = NULL;
+    h->root = meld(h->root, a);
+  }
+  h->count--;
+  min->child = NULL;
+  return min;
+}
@@ -0,0 +1,36 @@
+#ifndef _PHEAP_H_
+#define _PHEAP_H_
+
+/* Intrusive pairing heap ordered by a 64-bit key, smallest first. The
+   node lives inside the queued element, like the links of queue.h. Push
+   and meld are O(1) and pop is O(log n) amortized, with no allocation.
+   Elements with equal keys come out in no particular order. */
+
+struct pheap_node
+{
+  long long key;
+  struct pheap_node* child;     /* First child */
+  struct pheap_node* sibling;   /* Next sibling */
+};
+
+struct pheap
+{
+  struct pheap_node* root;
+  int count;
+};
+
+/* Initialize an empty heap */
+static inline void pheap_init(struct pheap* h) { h->root = NULL; h->count = 0; }
+
+/* Return 1 if the heap is empty and 0 otherwise */
+static inline int pheap_empty(struct pheap* h) { return (h->root == NULL); }
+
+/* Return the node with the smallest key without removing it, NULL if the heap is empty */
+static inline struct pheap_node* pheap_min(struct pheap* h) { return h->root; }
+
+/* Add n, whose key is set */
+void pheap_push(struct pheap* h, struct pheap_node* n);
+/* Remove the node with the smallest key. Returns NULL if the heap is empty */
+struct pheap_node* pheap_pop(struct pheap* h);
+
+#endif
@@ -4,9 +4,52 @@
 
 #include "queue.h"
 
+/* Nodes are recycled through a free list and allocated in chunks, so
+   enqueue() only calls malloc() when the pool runs dry */
+#define NODE_CHUNK 64
+
+static struct my_struct* free_nodes = NULL;
+
+static int node_refill(int n)
+{
+  struct my_struct* chunk = malloc(n * sizeof(struct my_struct));
+  int i;
+
+  if( NULL == chunk )
+    return -1;
+  for (i = 0; i < n - 1; i++)
+    chunk[i].next = &chunk[i + 1];
+  chunk[n - 1].next = free_nodes;
+  free_nodes = chunk;
+  return 0;
+}
+
+static struct my_struct* node_get(void)
+{
+  struct my_struct* p;
+
+  if( NULL == free_nodes && node_refill(NODE_CHUNK) == -1 )
+    return NULL;
+  p = free_nodes;
+  free_nodes = p->next;
+  return p;
+}
+
+static void node_put(struct my_struct* p)
+{
+  p->next = free_nodes;
+  free_nodes = p;
+}
+
+void queue_reserve(int n)
+{
+  if (n > 0 && node_refill(n) == -1)
+    fprintf(stderr, "IN %s, %s: malloc() failed\n", __FILE__, "queue_reserve");
+}
+
 struct queue* enqueue(struct queue* s, void * i)
 {
-  struct my_struct* p = malloc(sizeof(struct my_struct) );
+  struct my_struct* p = node_get();
 
   if( NULL == p )
     {
@@ -18,7 +61,7 @@ struct queue* enqueue(struct queue* s, void * i)
   if( NULL == s )
     {
       printf("Queue not initialized\n");
-      free(p);
+      node_put(p);
       return s;
     }
   else if( NULL == s->head && NULL == s->tail )
@@ -30,7 +73,7 @@ struct queue* enqueue(struct queue* s, void * i)
   else if( NULL == s->head || NULL == s->tail )
     {
       fprintf(stderr, "There is something seriously wrong with your assignment of head/tail to the list\n");
-      free(p);
+      node_put(p);
       return NULL;
     }
   else
@@ -69,9 +112,9 @@ void* dequeue( struct queue* s )
   h = s->head;
   p = h->next;
   ret = h->data;
-  free(h);
+  node_put(h);
   s->head = p;
-  if( NULL == s->head )  s->tail = s->head;   /* The element tail was pointing to is free(), so we need an update */
+  if( NULL == s->head )  s->tail = s->head;   /* The element tail was pointing to is released, so we need an update */
   return ret;
 }
 
@@ -103,13 +146,13 @@ void* queue_find_remove(struct queue* s, void * data )
  if ( s->head->data == data) {
    ret = data;
    if (s->head == s->tail){
-     free(s->head);
+     node_put(s->head);
      s->head = s->tail = NULL;
    }
    else {
      struct my_struct* aux = s->head;
      s->head = s->head->next;
-     free(aux);
+     node_put(aux);
    }
    return ret; 
  }
@@ -125,7 +168,7 @@ void* queue_find_remove(struct queue* s, void * data )
      if (aux->next->next == NULL )  // last element contains the searched data
        s->tail = aux;
      aux->next = aux->next->next;
-     free(aux2);
+     node_put(aux2);
      return ret;
    }
  } 
@@ -133,6 +176,26 @@ void* queue_find_remove(struct queue* s, void * data )
 
 int queue_empty ( struct queue* s ) { return (s->head == NULL); }
 
+/* Unlink l from the intrusive queue. Linear in the position of l */
+int iqueue_remove(struct iqueue* q, struct queue_link* l)
+{
+  struct queue_link* prev = NULL;
+  struct queue_link* aux;
+
+  for (aux = q->head; aux && aux != l; aux = aux->next)
+    prev = aux;
+  if (aux == NULL)
+    return 0;
+  if (prev == NULL)
+    q->head = l->next;
+  else
+    prev->next = l->next;
+  if (q->tail == l)
+    q->tail = prev;
+  l->next = NULL;
+  return 1;
+}
+
 struct queue* queue_new(void)
 {
   struct queue* p = malloc(sizeof(struct queue));
@@ -4,6 +4,8 @@
 #include  <stdio.h>
 #include  <stdlib.h>
 #include  <string.h>
+#include  <stddef.h>
+#include  <stdatomic.h>
 
 struct my_struct
 {
@@ -28,10 +30,112 @@ int queue_empty ( struct queue* s );
 void* queue_find_remove(struct queue* s, void * data );
 /* Create an empty queue */
 struct queue* queue_new(void);
+/* Preallocate n nodes so that the next n enqueues never call malloc() */
+void queue_reserve(int n);
 
 void queue_print(struct queue* );
 void queue_print_element(struct my_struct* );
 
-#endif
 
+/* Intrusive queue: the link lives inside the queued element (e.g. the TCB),
+   so enqueue and dequeue are a couple of pointer writes and never touch
+   the heap. An element can be linked in at most one intrusive queue. */
+struct queue_link
+{
+  struct queue_link* next;
+};
+
+struct iqueue
+{
+  struct queue_link* head;
+  struct queue_link* tail;
+};
+
+/* Get the element that contains the link */
+#define queue_entry(link, type, member) \
+  ((type *) ((char *) (link) - offsetof(type, member)))
+
+/* Initialize an empty intrusive queue */
+static inline void iqueue_init(struct iqueue* q) { q->head = q->tail = NULL; }
+
+/* Return 1 if the intrusive queue is empty and 0 otherwise */
+static inline int iqueue_empty(struct iqueue* q) { return (q->head == NULL); }
+
+/* Append a link at the tail */
+static inline void iqueue_push(struct iqueue* q, struct queue_link* l)
+{
+  l->next = NULL;
+  if (q->head == NULL)
+    q->head = l;
+  else
+    q->tail->next = l;
+  q->tail = l;
+}
+
+/* Remove the link at the head. Returns NULL if the queue is empty */
+static inline struct queue_link* iqueue_pop(struct iqueue* q)
+{
+  struct queue_link* l = q->head;
+  if (l != NULL) {
+    q->head = l->next;
+    if (q->head == NULL) q->tail = NULL;
+  }
+  return l;
+}
+
+/* Remove a given link from the queue. Returns 1 if found and 0 otherwise */
+int iqueue_remove(struct iqueue* q, struct queue_link* l);
 
+
+/* Lock-free multi-producer queue of links. Any thread or signal handler
+   can post with mpsc_push(); the consumer takes every posted link at once
+   with mpsc_take(), which is a single atomic exchange, so there is no ABA
+   problem and several consumers can take from it too. */
+struct mpsc
+{
+  _Atomic(struct queue_link*) head;   /* Last link posted */
+};
+
+/* Initialize an empty multi-producer queue */
+static inline void mpsc_init(struct mpsc* q) { atomic_init(&q->head, NULL); }
+
+/* Return 1 if nothing is posted and 0 otherwise */
+static inline int mpsc_empty(struct mpsc* q)
+{
+  return atomic_load_explicit(&q->head, memory_order_relaxed) == NULL;
+}
+
+/* Post a link. The element must stay alive until it is taken */
+static inline void mpsc_push(struct mpsc* q, struct queue_link* l)
+{
+  struct queue_link* h = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+  do {
+    l->next = h;
+  } while (!atomic_compare_exchange_weak_explicit(&q->head, &h, l,
+                                                  memory_order_release, memory_order_relaxed));
+}
+
+/* Move every posted link to the tail of out, the oldest first. Returns
+   how many there were */
+static inline int mpsc_take(struct mpsc* q, struct iqueue* out)
+{
+  struct queue_link* l = atomic_exchange_explicit(&q->head, NULL, memory_order_acquire);
+  struct queue_link* rev = NULL;
+  struct queue_link* next;
+  int n = 0;
+
+  /* The posted links are newest first */
+  for (; l != NULL; l = next, n++) {
+    next = l->next;
+    l->next = rev;
+    rev = l;
+  }
+  for (; rev != NULL; rev = next) {
+    next = rev->next;
+    iqueue_push(out, rev);
+  }
+  return n;
+}
+
+#endif
@@ -0,0 +1,79 @@
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+
+#include "runqueue.h"
+
+void rq_init(struct runqueue* rq)
+{
+  int i;
+
+  memset(rq->bitmap, 0, sizeof(rq->bitmap));
+  for (i = 0; i < MAX_PRIORITY; i++)
+    iqueue_init(&rq->level[i]);
+  rq->nr_running = 0;
+}
+
+void rq_push(struct runqueue* rq, struct queue_link* l, int prio)
+{
+  iqueue_push(&rq->level[prio], l);
+  rq->bitmap[prio / 64] |= 1ULL << (prio % 64);
+  rq->nr_running++;
+}
+
+int rq_top(struct runqueue* rq)
+{
+  int w;
+
+  for (w = RQ_WORDS - 1; w >= 0; w--)
+    if (rq->bitmap[w])
+      return w * 64 + 63 - __builtin_clzll(rq->bitmap[w]);
+  return -1;
+}
+
+int rq_next(struct runqueue* rq, int prio)
+{
+  int w = prio / 64;
+  unsigned long long bits;
+
+  if (prio < 0 || prio >= MAX_PRIORITY)
+    return -1;
+  bits = rq->bitmap[w] & (~0ULL << (prio % 64));
+  while (bits == 0) {
+    if (++w == RQ_WORDS)
+      return -1;
+    bits = rq->bitmap[w];
+  }
+  return w * 64 + __builtin_ctzll(bits);
+}
+
+struct queue_link* rq_pop(struct runqueue* rq)
+{
+  int prio = rq_top(rq);
+
+  if (prio < 0)
+    return NULL;
+  return rq_pop_level(rq, prio);
+}
+
+struct queue_link* rq_pop_level(struct runqueue* rq, int prio)
+{
+  struct queue_link* l = iqueue_pop(&rq->level[prio]);
+
+  if (l == NULL)
+    return NULL;
+  if (iqueue_empty(&rq->level[prio]))
+    rq->bitmap[prio / 64] &= ~(1ULL << (prio % 64));
+  rq->nr_running--;
+  return l;
+}
+
+int rq_remove(struct runqueue* rq, struct queue_link* l, int prio)
+{
+  if (!iqueue_remove(&rq->level[prio], l))
+    return 0;
+  if (iqueue_empty(&rq->level[prio]))
+    rq->bitmap[prio / 64] &= ~(1ULL << (prio % 64));
+  rq->nr_running--;
+  return 1;
+}
@@ -0,0 +1,41 @@
+#ifndef _RUNQUEUE_H_
+#define _RUNQUEUE_H_
+
+#include "queue.h"
+
+/* Number of priority levels: 0 is the lowest, MAX_PRIORITY-1 the highest */
+#define MAX_PRIORITY 140
+#define RQ_WORDS ((MAX_PRIORITY + 63) / 64)
+
+/* Multi-level run queue: one FIFO per priority level plus a bitmap with
+   one bit per non-empty level, so the highest ready level is found with a
+   find-first-set over RQ_WORDS words instead of checking every queue. */
+struct runqueue
+{
+  unsigned long long bitmap[RQ_WORDS];
+  struct iqueue level[MAX_PRIORITY];
+  int nr_running; /* number of queued elements */
+};
+
+/* Initialize an empty run queue */
+void rq_init(struct runqueue* rq);
+/* Append a link at the tail of level prio */
+void rq_push(struct runqueue* rq, struct queue_link* l, int prio);
+/* Remove the first link of the highest non-empty level. Returns NULL if the run queue is empty */
+struct queue_link* rq_pop(struct runqueue* rq);
+/* Return the highest non-empty level, or -1 if the run queue is empty */
+int rq_top(struct runqueue* rq);
+/* Return the lowest non-empty level from prio up, or -1 if there is none */
+int rq_next(struct runqueue* rq, int prio);
+/* Remove the first link of level prio. Returns NULL if the level is empty */
+struct queue_link* rq_pop_level(struct runqueue* rq, int prio);
+/* Remove a given link from level prio. Returns 1 if found and 0 otherwise */
+int rq_remove(struct runqueue* rq, struct queue_link* l, int prio);
+
+/* Return the first link of level prio without removing it, NULL if it is empty */
+static inline struct queue_link* rq_peek(struct runqueue* rq, int prio) { return rq->level[prio].head; }
+
+/* Return 1 if the run queue is empty and 0 otherwise */
+static inline int rq_empty(struct runqueue* rq) { return (rq->nr_running == 0); }
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include "mythread.h"
+
+/* Policy used when neither mythread_setpolicy() nor MYTHREAD_POLICY select one */
+#define DEFAULT_POLICY "rrfd"
+
+/* Scheduling policy. The core (mythreadlib.c) owns the thread table, the
+   contexts, the disk wait queue and the interrupts, and asks the policy for
+   every scheduling decision. Hooks are called with interrupts disabled. */
+struct sched_policy
+{
+  const char* name;
+  int disk;                               /* 1 if read_disk() blocks the thread until a disk interrupt */
+  int smp;                                /* 1 if the hooks can run on several workers at once (M:N mode) */
+  void (*init)(void);                     /* Initialize the policy run queues */
+  void (*enqueue)(TCB* t);                /* t was running and is ready again */
+  TCB* (*pick_next)(void);                /* Remove and return the next thread to run, NULL if there is none */
+  TCB* (*peek)(void);                     /* Return the thread pick_next() would, without removing it (optional) */
+  int (*on_tick)(TCB* running);           /* Clock tick: return 1 to preempt the running thread */
+  void (*on_block)(TCB* t);               /* t blocks in read_disk() (optional) */
+  int (*on_wakeup)(TCB* running, TCB* t); /* t is ready (new or disk completed): queue it and return 1 to preempt running */
+};
+
+/* Available policies: RR.c, RRF.c, RRFD.c, WS.c, CFS.c and MLFQ.c */
+extern struct sched_policy sched_rr;
+extern struct sched_policy sched_rrf;
+extern struct sched_policy sched_rrfd;
+extern struct sched_policy sched_ws;
+extern struct sched_policy sched_cfs;
+extern struct sched_policy sched_mlfq;
+
+/* Workers (kernel threads) running the green threads, and the index of
+   the calling one, from 0 to sched_nworkers()-1 */
+int sched_nworkers(void);
+int sched_worker_id(void);
+
+/* Clock of the accounting in nanoseconds (virtual in simulation mode). A
+   running thread has run stats.run_ns plus sched_now() - stamp */
+long long sched_now(void);
+
+/* Blocking on the wait queues of the synchronization objects (sync.c).
+   sched_block() makes the running thread BLOCKED and switches to another
+   one; once it is off the CPU, park(t) runs with the interrupts disabled
+   and either queues t on the object and returns 0, or returns 1 if t can
+   go on. sched_wake() makes ready a thread that park() queued, with the
+   interrupts disabled, and returns 1 if it should preempt the running
+   one; sched_preempt() then gives the CPU to the scheduler. */
+void sched_block(int (*park)(TCB* t), void* wait);
+int sched_wake(TCB* t);
+void sched_preempt(void);
+/* Make ready t, which park() queued, and switch straight to it unless it
+   has a lower priority than the running thread or the policy would not
+   run it next. The running thread goes back to the run queue. Called with
+   the interrupts enabled */
+void sched_handoff(TCB* t);
+
+/* EDF class (EDF.c), above the policy: its threads run before any other
+   and only the core calls it, with the interrupts disabled. edf_admit()
+   reserves CPU for t and returns -1 if it does not fit; edf_leave()
+   accounts for the last job of a finishing thread and frees its
+   reservation. edf_on_tick() and edf_complete() return 1 to preempt the
+   running thread, or EDF_SLEEP when it must wait until t->edf.release */
+#define EDF_SLEEP 2
+static inline int edf_thread(TCB* t) { return t->edf.period != 0; }
+void edf_init(void);
+int edf_admit(TCB* t, long long period, long long budget, long long deadline);
+void edf_leave(TCB* t);
+void edf_enqueue(TCB* t);
+TCB* edf_pick_next(void);
+TCB* edf_peek(void);
+int edf_on_tick(TCB* running);
+int edf_on_wakeup(TCB* running, TCB* t);
+int edf_complete(TCB* running);
+long long edf_budget_left(TCB* running);
+
+/* RRF hooks, shared with RRFD */
+void rrf_init(void);
+void rrf_enqueue(TCB* t);
+TCB* rrf_pick_next(void);
+TCB* rrf_peek(void);
+int rrf_on_tick(TCB* running);
+int rrf_on_wakeup(TCB* running, TCB* t);
+
+/* Set the weight of the running thread in the cfs policy, after charging
+   its run time at the old one */
+void cfs_setweight(TCB* running, int weight);
+
+#endif
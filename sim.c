@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+
+/* Binary min-heap of events by (time, sequence number) */
+struct event
+{
+  long long at;
+  long long period;
+  long seq;
+  void (*fire)(int);
+  int arg;
+};
+
+static struct event* heap = NULL;
+static int nevents = 0;
+static int max_events = 0;
+static long next_seq = 0;
+static long long now = 0;
+
+static int before(struct event* a, struct event* b)
+{
+  return a->at < b->at || (a->at == b->at && a->seq < b->seq);
+}
+
+static void push(struct event e)
+{
+  int i;
+
+  if (nevents == max_events) {
+    max_events = max_events ? 2 * max_events : 16;
+    heap = realloc(heap, max_events * sizeof(struct event));
+    if (heap == NULL) {
+      printf("*** ERROR: no memory for the simulation events\n");
+      exit(-1);
+    }
+  }
+  e.seq = next_seq++;
+  for (i = nevents++; i > 0 && before(&e, &heap[(i - 1) / 2]); i = (i - 1) / 2)
+    heap[i] = heap[(i - 1) / 2];
+  heap[i] = e;
+}
+
+static struct event pop(void)
+{
+  struct event top = heap[0];
+  struct event last = heap[--nevents];
+  int i = 0, c;
+
+  while ((c = 2 * i + 1) < nevents) {
+    if (c + 1 < nevents && before(&heap[c + 1], &heap[c]))
+      c++;
+    if (!before(&heap[c], &last))
+      break;
+    heap[i] = heap[c];
+    i = c;
+  }
+  heap[i] = last;
+  return top;
+}
+
+/* Take the first event, queue its next occurrence and fire it. It is off
+   the heap before it fires, since fire() can switch threads and the next
+   thread can advance the clock too */
+static void fire_next(void)
+{
+  struct event e = pop();
+
+  now = e.at;
+  if (e.period > 0) {
+    struct event again = e;
+    again.at += e.period;
+    push(again);
+  }
+  e.fire(e.arg);
+}
+
+void sim_event(long long at, long long period, void (*fire)(int), int arg)
+{
+  struct event e;
+
+  e.at = at;
+  e.period = period;
+  e.fire = fire;
+  e.arg = arg;
+  push(e);
+}
+
+long long sim_now(void)
+{
+  return now;
+}
+
+void sim_advance(long long ns)
+{
+  while (nevents > 0 && heap[0].at <= now + ns) {
+    /* What is left of ns goes on from wherever the clock is when this
+       thread runs again */
+    ns -= heap[0].at - now;
+    fire_next();
+  }
+  now += ns;
+}
+
+int sim_idle(void)
+{
+  if (nevents == 0)
+    return -1;
+  fire_next();
+  return 0;
+}
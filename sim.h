@@ -0,0 +1,26 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+/* Deterministic simulation mode (MYTHREAD_SIM, mythread_setsim()). There
+   are no OS timers: the clock is virtual and only advances when a thread
+   says it computes (mythread_compute()) or when every thread is blocked.
+   The clock and disk interrupts are events in a queue ordered by virtual
+   time, fired from the thread whose computation reaches them, so the same
+   program runs through the same events in the same order every time, as
+   fast as the CPU allows. */
+
+/* Queue an event that calls fire(arg) at virtual time at (ns), and then
+   every period ns if period > 0. Events at the same time fire in the
+   order they were queued */
+void sim_event(long long at, long long period, void (*fire)(int), int arg);
+/* Virtual time in nanoseconds */
+long long sim_now(void);
+/* Advance the clock by ns of computation of the calling thread, firing
+   the events that fall in it. The thread can be switched out by them and
+   goes on with what is left when it runs again */
+void sim_advance(long long ns);
+/* Nothing can run: jump to the next event and fire it. Returns -1 if
+   there is none */
+int sim_idle(void);
+
+#endif
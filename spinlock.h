@@ -0,0 +1,30 @@
+#ifndef _SPINLOCK_H_
+#define _SPINLOCK_H_
+
+#include <stdatomic.h>
+
+/* Test-and-set spin lock for the state shared by the workers in M:N mode.
+   The holder must keep the interrupts disabled: a handler that runs on the
+   same worker and takes the lock again would spin forever. */
+typedef struct
+{
+  atomic_flag flag;
+} spinlock_t;
+
+#define SPINLOCK_INIT { ATOMIC_FLAG_INIT }
+
+static inline void spin_lock(spinlock_t* l)
+{
+  while (atomic_flag_test_and_set_explicit(&l->flag, memory_order_acquire)) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+}
+
+static inline void spin_unlock(spinlock_t* l)
+{
+  atomic_flag_clear_explicit(&l->flag, memory_order_release);
+}
+
+#endif
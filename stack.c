@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "stack.h"
+#include "spinlock.h"
+
+#define MAX_CLASSES 8
+#define MAX_REGIONS 4096
+
+/* Free stacks of one size, linked through their lowest word */
+struct stack_class
+{
+  size_t size;           /* usable size, a multiple of the page size */
+  void* free;            /* cached stacks */
+  char* next;            /* next slot to carve in the current region */
+  char* end;             /* end of the current region */
+};
+
+/* mmap regions, kept to recognize guard page faults */
+struct stack_region
+{
+  char* start;
+  size_t slot;           /* guard page + stack */
+  size_t len;
+};
+
+static struct stack_class classes[MAX_CLASSES];
+static int nclasses = 0;
+static struct stack_region regions[MAX_REGIONS];
+static int nregions = 0;
+static size_t page_size = 0;
+/* The pool is shared by the workers in M:N mode. The callers keep the
+   preemption disabled, as spin_lock() requires. stack_is_guard() runs in
+   the fault handler and reads the regions without it: they are only
+   appended, and nregions grows after the entry is written */
+static spinlock_t stack_lock = SPINLOCK_INIT;
+
+size_t stack_round(size_t size)
+{
+  if (page_size == 0) page_size = sysconf(_SC_PAGESIZE);
+  return (size + page_size - 1) & ~(page_size - 1);
+}
+
+static struct stack_class* find_class(size_t size)
+{
+  int i;
+
+  for (i = 0; i < nclasses; i++)
+    if (classes[i].size == size)
+      return &classes[i];
+  if (nclasses == MAX_CLASSES)
+    return NULL;
+  classes[nclasses].size = size;
+  classes[nclasses].free = NULL;
+  classes[nclasses].next = classes[nclasses].end = NULL;
+  return &classes[nclasses++];
+}
+
+/* Map a new region for class c. The whole region starts as PROT_NONE and
+   each stack is made accessible when it is carved, leaving its guard page */
+static int region_grow(struct stack_class* c)
+{
+  size_t slot = c->size + page_size;
+  size_t len = slot * STACKS_PER_REGION;
+  char* p;
+
+  if (nregions == MAX_REGIONS)
+    return -1;
+  p = mmap(NULL, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED)
+    return -1;
+  regions[nregions].start = p;
+  regions[nregions].slot = slot;
+  regions[nregions].len = len;
+  __atomic_store_n(&nregions, nregions + 1, __ATOMIC_RELEASE);
+  c->next = p;
+  c->end = p + len;
+  return 0;
+}
+
+void* stack_alloc(size_t size)
+{
+  struct stack_class* c;
+  char* stack = NULL;
+
+  size = stack_round(size);
+  spin_lock(&stack_lock);
+  c = find_class(size);
+  if (c == NULL)
+    goto out;
+  if (c->free != NULL) {
+    stack = c->free;
+    c->free = *(void**) stack;
+    goto out;
+  }
+  if (c->next == c->end && region_grow(c) == -1)
+    goto out;
+  if (mprotect(c->next + page_size, c->size, PROT_READ | PROT_WRITE) == -1)
+    goto out;
+  stack = c->next + page_size;
+  c->next += c->size + page_size;
+out:
+  spin_unlock(&stack_lock);
+  return stack;
+}
+
+void stack_free(void* stack, size_t size)
+{
+  struct stack_class* c;
+
+  if (stack == NULL)
+    return;
+  size = stack_round(size);
+  spin_lock(&stack_lock);
+  c = find_class(size);
+  /* The link is stored at the bottom of the stack, the end a finished
+     thread used last */
+  if (c != NULL) {
+    *(void**) stack = c->free;
+    c->free = stack;
+  }
+  spin_unlock(&stack_lock);
+}
+
+int stack_is_guard(void* addr)
+{
+  char* a = addr;
+  int i;
+
+  for (i = 0; i < __atomic_load_n(&nregions, __ATOMIC_ACQUIRE); i++)
+    if (a >= regions[i].start && a < regions[i].start + regions[i].len)
+      return ((uintptr_t) (a - regions[i].start) % regions[i].slot) < page_size;
+  return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef _STACK_H_
+#define _STACK_H_
+
+#include <stddef.h>
+
+/* Thread stacks are carved out of large mmap regions. Every stack is page
+   aligned and has a PROT_NONE guard page right below it, so an overflow
+   faults at once instead of corrupting the neighbour. Freed stacks are
+   cached per size and reused, so in steady state allocating a stack does
+   not make any system call. */
+
+/* Number of stacks carved out of each mmap region */
+#define STACKS_PER_REGION 64
+
+/* Return a stack of at least size bytes (the lowest usable address), or NULL if there is no memory */
+void* stack_alloc(size_t size);
+/* Give back a stack obtained with stack_alloc(size) to the cache */
+void stack_free(void* stack, size_t size);
+/* Usable size of the stacks returned by stack_alloc(size) */
+size_t stack_round(size_t size);
+/* Return 1 if addr falls in the guard page of a stack and 0 otherwise */
+int stack_is_guard(void* addr);
+
+#endif
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mythread.h"
+#include "sched.h"
+
+/* See sync.h. The wait queues are under the spin lock of their object,
+   which is only taken with the interrupts disabled. A waiter is queued by
+   its park function once it is off the CPU (see sched_block()), so the
+   thread that releases the object always finds it parked. */
+
+/* Wake t, which was taken from a wait queue, and give it the CPU if the
+   policy says so */
+static void wake(TCB* t)
+{
+  int preempt;
+
+  preempt_disable();
+  preempt = sched_wake(t);
+  preempt_enable();
+  if (preempt)
+    sched_preempt();
+}
+
+void mythread_mutex_init(mythread_mutex_t* m)
+{
+  atomic_init(&m->state, 0);
+  atomic_flag_clear(&m->lock.flag);
+  iqueue_init(&m->waiters);
+}
+
+/* Queue a thread that found the mutex taken, unless it was released in
+   the meantime: then the thread has it */
+static int park_mutex(TCB* t)
+{
+  mythread_mutex_t* m = t->wait;
+  int taken;
+
+  spin_lock(&m->lock);
+  taken = atomic_exchange(&m->state, 2) == 0;
+  if (!taken)
+    tcb_enqueue(&m->waiters, t);
+  spin_unlock(&m->lock);
+  return taken;
+}
+
+void mythread_mutex_lock(mythread_mutex_t* m)
+{
+  int free = 0;
+
+  if (atomic_compare_exchange_strong(&m->state, &free, 1))
+    return;
+  /* The thread that unlocks it hands it over */
+  sched_block(park_mutex, m);
+}
+
+int mythread_mutex_trylock(mythread_mutex_t* m)
+{
+  int free = 0;
+
+  return atomic_compare_exchange_strong(&m->state, &free, 1) ? 0 : -1;
+}
+
+/* Release m, which has or had waiters, and return the waiter that gets
+   it, if any. Called with the interrupts disabled */
+static TCB* mutex_handoff(mythread_mutex_t* m)
+{
+  TCB* t;
+
+  spin_lock(&m->lock);
+  t = tcb_dequeue(&m->waiters);
+  /* The mutex stays taken for t */
+  if (t == NULL)
+    atomic_store(&m->state, 0);
+  else if (iqueue_empty(&m->waiters))
+    atomic_store(&m->state, 1);
+  spin_unlock(&m->lock);
+  return t;
+}
+
+void mythread_mutex_unlock(mythread_mutex_t* m)
+{
+  int taken = 1;
+  TCB* t;
+
+  if (atomic_compare_exchange_strong(&m->state, &taken, 0))
+    return;
+  preempt_disable();
+  t = mutex_handoff(m);
+  preempt_enable();
+  if (t != NULL)
+    wake(t);
+}
+
+void mythread_cond_init(mythread_cond_t* c)
+{
+  atomic_flag_clear(&c->lock.flag);
+  iqueue_init(&c->waiters);
+}
+
+/* A thread in mythread_cond_wait() */
+struct cond_wait
+{
+  mythread_cond_t* c;
+  mythread_mutex_t* m;
+};
+
+/* Queue the waiter and only then release its mutex, so that a signal
+   sent after the release finds it. Once it is queued, another worker can
+   wake it and cw can be gone */
+static int park_cond(TCB* t)
+{
+  struct cond_wait* cw = t->wait;
+  mythread_cond_t* c = cw->c;
+  mythread_mutex_t* m = cw->m;
+  TCB* next = NULL;
+  int taken = 1;
+
+  spin_lock(&c->lock);
+  tcb_enqueue(&c->waiters, t);
+  spin_unlock(&c->lock);
+  /* This runs in the middle of a switch: the new owner of the mutex does
+     not preempt the thread that got the CPU */
+  if (!atomic_compare_exchange_strong(&m->state, &taken, 0))
+    next = mutex_handoff(m);
+  if (next != NULL)
+    sched_wake(next);
+  return 0;
+}
+
+void mythread_cond_wait(mythread_cond_t* c, mythread_mutex_t* m)
+{
+  struct cond_wait cw = { c, m };
+
+  sched_block(park_cond, &cw);
+  mythread_mutex_lock(m);
+}
+
+void mythread_cond_signal(mythread_cond_t* c)
+{
+  TCB* t;
+
+  preempt_disable();
+  spin_lock(&c->lock);
+  t = tcb_dequeue(&c->waiters);
+  spin_unlock(&c->lock);
+  preempt_enable();
+  if (t != NULL)
+    wake(t);
+}
+
+void mythread_cond_broadcast(mythread_cond_t* c)
+{
+  struct iqueue q;
+  int preempt = 0;
+  TCB* t;
+
+  preempt_disable();
+  spin_lock(&c->lock);
+  q = c->waiters;
+  iqueue_init(&c->waiters);
+  spin_unlock(&c->lock);
+  while ((t = tcb_dequeue(&q)) != NULL)
+    preempt |= sched_wake(t);
+  preempt_enable();
+  if (preempt)
+    sched_preempt();
+}
+
+void mythread_sem_init(mythread_sem_t* s, int value)
+{
+  atomic_init(&s->count, value);
+  s->wakeups = 0;
+  atomic_flag_clear(&s->lock.flag);
+  iqueue_init(&s->waiters);
+}
+
+/* Queue a thread that took a unit it does not have yet, unless a post
+   came for it before it was parked */
+static int park_sem(TCB* t)
+{
+  mythread_sem_t* s = t->wait;
+  int posted;
+
+  spin_lock(&s->lock);
+  posted = s->wakeups > 0;
+  if (posted)
+    s->wakeups--;
+  else
+    tcb_enqueue(&s->waiters, t);
+  spin_unlock(&s->lock);
+  return posted;
+}
+
+void mythread_sem_wait(mythread_sem_t* s)
+{
+  if (atomic_fetch_sub(&s->count, 1) > 0)
+    return;
+  sched_block(park_sem, s);
+}
+
+int mythread_sem_trywait(mythread_sem_t* s)
+{
+  int c = atomic_load(&s->count);
+
+  while (c > 0)
+    if (atomic_compare_exchange_weak(&s->count, &c, c - 1))
+      return 0;
+  return -1;
+}
+
+void mythread_sem_post(mythread_sem_t* s)
+{
+  TCB* t;
+
+  if (atomic_fetch_add(&s->count, 1) >= 0)
+    return;
+  /* A thread waits for this unit: give it to the first one parked */
+  preempt_disable();
+  spin_lock(&s->lock);
+  t = tcb_dequeue(&s->waiters);
+  if (t == NULL)
+    s->wakeups++;
+  spin_unlock(&s->lock);
+  preempt_enable();
+  if (t != NULL)
+    wake(t);
+}
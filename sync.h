@@ -0,0 +1,41 @@
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include <stdatomic.h>
+
+#include "queue.h"
+#include "spinlock.h"
+
+/* Mutexes, condition variables and counting semaphores of the green
+   threads. Taking a free mutex or a semaphore with a positive count is a
+   single atomic operation and never enters the scheduler. A thread that
+   has to wait is BLOCKED on the wait queue of the object, in FIFO order,
+   and the thread that releases the object hands it over directly. The
+   functions are in mythread.h; the objects must be initialized with the
+   init functions or the static initializers below. */
+
+typedef struct
+{
+  atomic_int state;        /* 0 free, 1 taken, 2 taken and maybe waiters */
+  spinlock_t lock;         /* Of the wait queue */
+  struct iqueue waiters;
+} mythread_mutex_t;
+
+typedef struct
+{
+  spinlock_t lock;
+  struct iqueue waiters;
+} mythread_cond_t;
+
+typedef struct
+{
+  atomic_int count;        /* Below 0: threads that wait or are about to */
+  int wakeups;             /* Posts for waiters not parked yet, under lock */
+  spinlock_t lock;
+  struct iqueue waiters;
+} mythread_sem_t;
+
+#define MYTHREAD_MUTEX_INITIALIZER { 0, SPINLOCK_INIT, { NULL, NULL } }
+#define MYTHREAD_COND_INITIALIZER { SPINLOCK_INIT, { NULL, NULL } }
+
+#endif
@@ -0,0 +1,145 @@
+/* Decode a scheduler trace (see trace.h) into Chrome trace JSON, for
+   chrome://tracing or ui.perfetto.dev. Every worker is a track: the time
+   a thread holds the CPU is a slice named after it, and the other events
+   are instants on the worker that recorded them.
+
+   Usage: trace2json [trace [json]]   (default mythread.trace and stdout) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/* Slice open on a worker */
+struct track
+{
+  int tid;             /* Thread on the CPU, -2 if not known yet */
+  long long since;     /* When it got it */
+};
+
+static struct track* tracks = NULL;
+static int ntracks = 0;
+static int first = 1;
+
+static void comma(FILE* out)
+{
+  fprintf(out, first ? "\n" : ",\n");
+  first = 0;
+}
+
+static struct track* track(FILE* out, int w)
+{
+  while (w >= ntracks) {
+    tracks = realloc(tracks, (ntracks + 1) * sizeof(struct track));
+    if (tracks == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+    tracks[ntracks].tid = -2;
+    comma(out);
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+            ntracks, ntracks);
+    ntracks++;
+  }
+  return &tracks[w];
+}
+
+/* Close the slice of the thread on worker w at ts; the idle thread has none */
+static void slice(FILE* out, int w, long long ts)
+{
+  struct track* t = &tracks[w];
+
+  if (t->tid >= 0) {
+    comma(out);
+    fprintf(out, "{\"name\":\"thread %d\",\"cat\":\"run\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+            "\"pid\":0,\"tid\":%d,\"args\":{\"thread\":%d}}",
+            t->tid, t->since / 1e3, (ts - t->since) / 1e3, w, t->tid);
+  }
+}
+
+static void instant(FILE* out, const char* name, const struct trace_rec* r, long long ts)
+{
+  comma(out);
+  fprintf(out, "{\"name\":\"%s\",\"cat\":\"sched\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+          "\"pid\":0,\"tid\":%d,\"args\":{\"thread\":%d}}",
+          name, ts / 1e3, r->worker, r->tid);
+}
+
+int main(int argc, char *argv[])
+{
+  const char* in_path = argc > 1 ? argv[1] : TRACE_FILE;
+  struct trace_header h;
+  struct trace_rec* recs;
+  long long t0, end = 0;
+  FILE *in, *out = stdout;
+  unsigned i;
+  int w;
+
+  in = fopen(in_path, "rb");
+  if (in == NULL) {
+    perror(in_path);
+    return 1;
+  }
+  if (fread(&h, sizeof(h), 1, in) != 1 || memcmp(h.magic, TRACE_MAGIC, sizeof(h.magic)) != 0
+      || h.rec_size != sizeof(struct trace_rec)) {
+    fprintf(stderr, "%s: not a scheduler trace\n", in_path);
+    return 1;
+  }
+  recs = malloc((h.count + 1) * sizeof(struct trace_rec));
+  if (recs == NULL || fread(recs, sizeof(struct trace_rec), h.count, in) != h.count) {
+    fprintf(stderr, "%s: truncated trace\n", in_path);
+    return 1;
+  }
+  fclose(in);
+  if (argc > 2 && (out = fopen(argv[2], "w")) == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+  if (h.lost > 0)
+    fprintf(stderr, "trace2json: %llu older records were overwritten\n", (unsigned long long) h.lost);
+
+  t0 = h.count > 0 ? recs[0].ts_ns : 0;
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (i = 0; i < h.count; i++) {
+    const struct trace_rec* r = &recs[i];
+    long long ts = r->ts_ns - t0;
+    struct track* t;
+
+    if (r->worker < 0)
+      continue;
+    t = track(out, r->worker);
+    if (ts > end)
+      end = ts;
+    switch (r->type) {
+    case TRACE_SWITCH:
+    case TRACE_PREEMPT:
+    case TRACE_TERMINATED:
+      /* The first switch of a worker tells who was running since the start */
+      if (t->tid == -2) {
+        t->tid = r->tid;
+        t->since = 0;
+      }
+      slice(out, r->worker, ts);
+      if (r->type != TRACE_SWITCH)
+        instant(out, r->type == TRACE_PREEMPT ? "preempted" : "terminated", r, ts);
+      t->tid = r->arg;
+      t->since = ts;
+      break;
+    case TRACE_FINISHED:
+      instant(out, "finished", r, ts);
+      break;
+    case TRACE_BLOCK:
+      instant(out, "read_disk", r, ts);
+      break;
+    case TRACE_READY:
+      instant(out, "ready", r, ts);
+      break;
+    }
+  }
+  for (w = 0; w < ntracks; w++)
+    slice(out, w, end);
+  fprintf(out, "\n]}\n");
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
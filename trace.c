@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "trace.h"
+#include "sched.h"
+
+/* Only built with MYTHREAD_TRACE, see trace.h */
+
+static struct trace_rec* ring = NULL;
+static unsigned long mask = 0;
+static atomic_ulong head = 0;
+
+/* Write the ring to MYTHREAD_TRACE_FILE, the oldest record first */
+static void trace_dump(void)
+{
+  const char* path = getenv("MYTHREAD_TRACE_FILE");
+  struct trace_header h;
+  unsigned long end = atomic_load(&head);
+  unsigned long first, i;
+  int fd;
+
+  if (path == NULL)
+    path = TRACE_FILE;
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    perror(path);
+    return;
+  }
+  first = end > mask + 1 ? end - (mask + 1) : 0;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+  h.rec_size = sizeof(struct trace_rec);
+  h.count = end - first;
+  h.lost = first;
+  if (write(fd, &h, sizeof(h)) != sizeof(h))
+    perror(path);
+  /* At most two pieces: up to the end of the ring and from its start */
+  for (i = first; i < end; ) {
+    unsigned long n = mask + 1 - (i & mask);
+
+    if (n > end - i)
+      n = end - i;
+    if (write(fd, &ring[i & mask], n * sizeof(struct trace_rec)) != n * sizeof(struct trace_rec)) {
+      perror(path);
+      break;
+    }
+    i += n;
+  }
+  close(fd);
+}
+
+void trace_init(void)
+{
+  const char* env = getenv("MYTHREAD_TRACE_SIZE");
+  unsigned long want = env ? strtoul(env, NULL, 0) : TRACE_RECORDS;
+  unsigned long n;
+
+  for (n = 1; n < want; n <<= 1);
+  /* Touch the whole ring now so that recording never faults in a page */
+  ring = malloc(n * sizeof(struct trace_rec));
+  if (ring == NULL) {
+    printf("*** ERROR: no memory for the trace buffer\n");
+    exit(-1);
+  }
+  memset(ring, 0, n * sizeof(struct trace_rec));
+  mask = n - 1;
+  atexit(trace_dump);
+}
+
+void trace_record(int type, int tid, int arg)
+{
+  unsigned long i = atomic_fetch_add_explicit(&head, 1, memory_order_relaxed);
+  struct trace_rec* r = &ring[i & mask];
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  r->ts_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  r->type = type;
+  r->worker = sched_worker_id();
+  r->tid = tid;
+  r->arg = arg;
+}
@@ -0,0 +1,55 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+/* Binary trace of the scheduler. Built with MYTHREAD_TRACE (make TRACE=1),
+   every scheduling event is a fixed-size record in a ring buffer allocated
+   at start instead of a line on stdout. Recording one costs a clock read
+   and an atomic increment, with no lock and no stdio, so the signal
+   handlers can record too. The ring keeps the last records and is written
+   to MYTHREAD_TRACE_FILE (default mythread.trace) at exit; the decoder
+   tools/trace2json turns it into Chrome trace JSON. Without MYTHREAD_TRACE
+   the ring and its calls are not built at all. */
+
+#define TRACE_MAGIC "MYTRACE1"
+#define TRACE_RECORDS (1 << 16)   /* Default size of the ring (MYTHREAD_TRACE_SIZE) */
+#define TRACE_FILE "mythread.trace"
+
+/* Events, one per message of the untraced build */
+enum trace_type
+{
+  TRACE_SWITCH = 1,    /* tid left the CPU to arg */
+  TRACE_PREEMPT,       /* tid was preempted by arg */
+  TRACE_TERMINATED,    /* tid finished and arg got the CPU */
+  TRACE_FINISHED,      /* tid called mythread_exit() */
+  TRACE_BLOCK,         /* tid waits for the disk */
+  TRACE_READY,         /* tid was woken up */
+};
+
+struct trace_rec
+{
+  int64_t ts_ns;       /* CLOCK_MONOTONIC */
+  int32_t type;
+  int32_t worker;      /* Worker that recorded it */
+  int32_t tid;         /* -1 is the idle thread */
+  int32_t arg;
+};
+
+/* The file is this header followed by count records, the oldest first */
+struct trace_header
+{
+  char magic[8];
+  uint32_t rec_size;   /* sizeof(struct trace_rec) */
+  uint32_t count;
+  uint64_t lost;       /* Older records that were overwritten */
+};
+
+#ifdef MYTHREAD_TRACE
+/* Allocate the ring and write it out at exit */
+void trace_init(void);
+/* Record an event of the running worker */
+void trace_record(int type, int tid, int arg);
+#endif
+
+#endif
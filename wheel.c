@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wheel.h"
+
+#define MASK (WHEEL_SLOTS - 1)
+
+void wheel_init(struct wheel* w, unsigned long long now)
+{
+  int l, i;
+
+  for (l = 0; l < WHEEL_LEVELS; l++)
+    for (i = 0; i < WHEEL_SLOTS; i++)
+      iqueue_init(&w->slot[l][i]);
+  w->next = now;
+  w->count = 0;
+}
+
+/* Queue t in the slot of its level, without counting it */
+static void place(struct wheel* w, struct wtimer* t)
+{
+  unsigned long long delta;
+  int l;
+
+  if (t->expires < w->next)
+    t->expires = w->next;
+  delta = t->expires - w->next;
+  for (l = 0; l < WHEEL_LEVELS - 1 && delta >= 1ULL << (WHEEL_BITS * (l + 1)); l++);
+  if (delta >= 1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+    t->expires = w->next + (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+  iqueue_push(&w->slot[l][(t->expires >> (WHEEL_BITS * l)) & MASK], &t->link);
+}
+
+void wheel_add(struct wheel* w, struct wtimer* t)
+{
+  place(w, t);
+  w->count++;
+}
+
+/* Move the timers of the slot of level l that starts at tick n one level
+   down, after the levels above it have done the same */
+static void cascade(struct wheel* w, int l, unsigned long long n)
+{
+  int idx = (n >> (WHEEL_BITS * l)) & MASK;
+  struct iqueue q = w->slot[l][idx];
+  struct queue_link* link;
+
+  if (idx == 0 && l + 1 < WHEEL_LEVELS)
+    cascade(w, l + 1, n);
+  iqueue_init(&w->slot[l][idx]);
+  while ((link = iqueue_pop(&q)) != NULL)
+    place(w, queue_entry(link, struct wtimer, link));
+}
+
+int wheel_advance(struct wheel* w, unsigned long long now, struct iqueue* expired)
+{
+  struct queue_link* link;
+  int n = 0;
+
+  for (; w->next <= now; w->next++) {
+    struct iqueue* s;
+
+    /* Nothing to expire or to move down: jump to the end */
+    if (w->count == 0) {
+      w->next = now + 1;
+      break;
+    }
+    if ((w->next & MASK) == 0)
+      cascade(w, 1, w->next);
+    s = &w->slot[0][w->next & MASK];
+    while ((link = iqueue_pop(s)) != NULL) {
+      iqueue_push(expired, link);
+      w->count--;
+      n++;
+    }
+  }
+  return n;
+}
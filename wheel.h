@@ -0,0 +1,39 @@
+#ifndef _WHEEL_H_
+#define _WHEEL_H_
+
+#include "queue.h"
+
+/* Hierarchical timer wheel. Time is counted in ticks; level l has
+   WHEEL_SLOTS slots of WHEEL_SLOTS^l ticks each, so a timer goes to the
+   level that matches how far away it is. Adding a timer is O(1), and
+   advancing one tick is O(1) plus the timers that expire or move down a
+   level, which happens at most once per level for each timer. Timers
+   further than WHEEL_SLOTS^WHEEL_LEVELS ticks expire at that distance.
+   There is no cancel: a timer stays until it expires. */
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+
+struct wtimer
+{
+  struct queue_link link;
+  unsigned long long expires;   /* Tick at which it expires */
+};
+
+struct wheel
+{
+  unsigned long long next;      /* First tick not processed yet */
+  long count;                   /* Timers in the wheel */
+  struct iqueue slot[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+/* Initialize an empty wheel whose first tick to process is now */
+void wheel_init(struct wheel* w, unsigned long long now);
+/* Add t, which expires at tick t->expires (the next tick if it is past) */
+void wheel_add(struct wheel* w, struct wtimer* t);
+/* Process every tick up to now, moving the expired timers to the tail of
+   expired. Returns how many expired */
+int wheel_advance(struct wheel* w, unsigned long long now, struct iqueue* expired);
+
+#endif